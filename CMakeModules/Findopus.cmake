@@ -0,0 +1,18 @@
+
+FIND_PATH(OPUS_INCLUDE_DIR opus/opus.h /usr/include /usr/local/include)
+FIND_LIBRARY(OPUS_LIBRARY NAMES opus PATH /usr/lib /usr/local/lib)
+
+IF (OPUS_INCLUDE_DIR AND OPUS_LIBRARY)
+	SET(OPUS_FOUND TRUE)
+ENDIF (OPUS_INCLUDE_DIR AND OPUS_LIBRARY)
+
+IF (OPUS_FOUND)
+	IF (NOT opus_FIND_QUIETLY)
+		MESSAGE(STATUS "Found opus: ${OPUS_INCLUDE_DIR}/opus/opus.h ${OPUS_LIBRARY}")
+	ENDIF (NOT opus_FIND_QUIETLY)
+ELSE (OPUS_FOUND)
+	IF (opus_FIND_REQUIRED)
+		MESSAGE(FATAL_ERROR "Could not find opus")
+	ENDIF (opus_FIND_REQUIRED)
+ENDIF (OPUS_FOUND)
+
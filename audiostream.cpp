@@ -0,0 +1,127 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+#include <QSocketNotifier>
+#include <QString>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include "audiostream.h"
+#include "common.h"
+#include "ringbuffer.h"
+
+// AudioStream
+
+AudioStream::AudioStream(int d, QObject *parent) :
+	QObject(parent),
+	fd(d),
+	buffer(NULL),
+	bytes(0),
+	packets(0)
+{
+	int flags = fcntl(fd, F_GETFL, 0);
+	if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1)
+		debug("WARNING: AudioStream: failed to make socket non-blocking");
+
+	notifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+	// stay quiet until we know where to put the data
+	notifier->setEnabled(false);
+	connect(notifier, SIGNAL(activated(int)), this, SLOT(readData()));
+}
+
+AudioStream::~AudioStream() {
+	close();
+}
+
+void AudioStream::setBuffer(RingBuffer *b) {
+	buffer = b;
+	if (notifier)
+		notifier->setEnabled(buffer != NULL);
+}
+
+void AudioStream::close() {
+	if (fd < 0)
+		return;
+
+	// the notifier must go away before the descriptor is closed
+	delete notifier;
+	notifier = NULL;
+	::close(fd);
+	fd = -1;
+}
+
+void AudioStream::readData() {
+	bool gotData = false;
+	bool eof = false;
+
+	while (fd >= 0) {
+		buffer->makeRoom();
+
+		ssize_t n = ::read(fd, buffer->writePointer(), buffer->writeSize());
+
+		if (n > 0) {
+			buffer->commit(n);
+			bytes += n;
+			packets++;
+			gotData = true;
+			continue;
+		}
+
+		if (n < 0 && errno == EINTR)
+			continue;
+
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+
+		// end of stream or a real error
+		if (n < 0)
+			debug(QString("AudioStream: read error: %1").arg(errno));
+		eof = true;
+		break;
+	}
+
+	if (eof)
+		close();
+
+	if (gotData)
+		emit readyRead();
+
+	if (eof)
+		emit disconnected();
+}
+
+// AudioServer
+
+AudioServer::AudioServer(QObject *parent) : QTcpServer(parent) {
+}
+
+void AudioServer::incomingConnection(int descriptor) {
+	pending.append(new AudioStream(descriptor, this));
+}
+
+AudioStream *AudioServer::nextPendingStream() {
+	if (pending.isEmpty())
+		return NULL;
+	return pending.takeFirst();
+}
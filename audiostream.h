@@ -0,0 +1,91 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+#ifndef AUDIOSTREAM_H
+#define AUDIOSTREAM_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QList>
+
+#include "common.h"
+
+class QSocketNotifier;
+class RingBuffer;
+
+// the receiving end of one of Skype's PCM streams.  instead of going through
+// QTcpSocket, which allocates a new QByteArray for every packet, this reads
+// from the socket straight into the free space of a RingBuffer
+
+class AudioStream : public QObject {
+	Q_OBJECT
+public:
+	AudioStream(int, QObject *);
+	~AudioStream();
+
+	void setBuffer(RingBuffer *);
+	bool isOpen() const { return fd >= 0; }
+	void close();
+
+	// a packet is whatever a single read() returned, which usually is
+	// one of the 10ms blocks Skype sends
+	qint64 bytesReceived() const { return bytes; }
+	qint64 packetsReceived() const { return packets; }
+
+signals:
+	void readyRead();
+	void disconnected();
+
+private slots:
+	void readData();
+
+private:
+	int fd;
+	QSocketNotifier *notifier;
+	RingBuffer *buffer;
+	qint64 bytes;
+	qint64 packets;
+
+	DISABLE_COPY_AND_ASSIGNMENT(AudioStream);
+};
+
+// a server that hands out AudioStreams instead of QTcpSockets.  it still
+// emits newConnection() for every incoming connection
+
+class AudioServer : public QTcpServer {
+	Q_OBJECT
+public:
+	AudioServer(QObject *);
+	AudioStream *nextPendingStream();
+
+protected:
+	void incomingConnection(int);
+
+private:
+	QList<AudioStream *> pending;
+
+	DISABLE_COPY_AND_ASSIGNMENT(AudioServer);
+};
+
+#endif
+
@@ -23,8 +23,6 @@
 
 #include <QStringList>
 #include <QList>
-#include <QTcpServer>
-#include <QTcpSocket>
 #include <QMessageBox>
 #include <cstdlib>
 #include <cmath>
@@ -34,15 +32,21 @@
 #include "common.h"
 #include "skype.h"
 #include "wavewriter.h"
-#include "mp3writer.h"
-#include "vorbiswriter.h"
+#include "writer.h"
+#include "segmentingwriter.h"
+#include "encoder.h"
+#include "mixer.h"
+#include "audiostream.h"
 #include "preferences.h"
+#include "filename.h"
 #include "gui.h"
 
-// AutoSync - automatic resynchronization of the two streams.  this class has a
+// AutoSync - coarse resynchronization of the two streams.  this class has a
 // circular buffer that keeps track of the delay between the two streams.  it
 // calculates the running average and deviation and then tells if and how much
-// correction should be applied.
+// correction should be applied.  small delays and clock drift are handled by
+// resampling (see Call::tryToWrite()), this is only for when a stream has lost
+// a noticeable amount of data.
 
 AutoSync::AutoSync(int s, long p) :
 	size(s),
@@ -88,6 +92,128 @@ void AutoSync::reset() {
 	suppress = size;
 }
 
+// DriftEstimator - the sound devices that produce the two streams run on
+// independent clocks, so one stream slowly gets ahead of the other.  each
+// observation is the number of local samples received so far (x) and how many
+// more remote samples than local ones have been received (y).  the slope of y
+// over x is the drift.  the regression is exponentially weighted, so it
+// follows slow changes and needs constant memory.  observations come in about
+// 200 times per second, which makes the time constant about 30 seconds
+
+namespace {
+	const double driftWeight = 1.0 / 6000.0;
+	const long driftMinimumCount = 2000;  // about 10 seconds
+	const double maxDrift = 0.005;
+}
+
+DriftEstimator::DriftEstimator() {
+	reset();
+}
+
+void DriftEstimator::reset() {
+	meanX = meanY = varX = covXY = 0.0;
+	count = 0;
+	restarting = false;
+}
+
+// inserting silence into a stream shifts all later observations by an
+// unknown amount: by the padding if the other stream was merely late, not
+// at all if data was lost.  either way, mixing observations from before and
+// after would skew the slope for as long as the old ones carry weight.  the
+// variance and covariance don't depend on where the line is, so they are
+// kept, and the means start over from the next observation
+
+void DriftEstimator::restart() {
+	restarting = count != 0;
+}
+
+void DriftEstimator::add(double x, double y) {
+	if (count++ == 0 || restarting) {
+		meanX = x;
+		meanY = y;
+		restarting = false;
+		return;
+	}
+
+	// use equal weights at first, so the start does not get too much weight
+	double w = 1.0 / (double)count;
+	if (w < driftWeight)
+		w = driftWeight;
+
+	double dx = x - meanX;
+	double dy = y - meanY;
+	meanX += w * dx;
+	meanY += w * dy;
+	varX = (1.0 - w) * (varX + w * dx * dx);
+	covXY = (1.0 - w) * (covXY + w * dx * dy);
+}
+
+double DriftEstimator::drift() const {
+	if (count < driftMinimumCount || varX <= 0.0)
+		return 0.0;
+
+	double d = covXY / varX;
+
+	if (d > maxDrift)
+		return maxDrift;
+	if (d < -maxDrift)
+		return -maxDrift;
+	return d;
+}
+
+// BatchPolicy - the batch size is configured as a latency in milliseconds.
+// in adaptive mode, the size doubles whenever blocks pile up in the encoder
+// queue, and it slowly goes back to the configured latency when the encoder
+// is keeping up again, and down to the minimum while the encoder is idle.
+// the size always stays within the configured bounds
+
+BatchPolicy::BatchPolicy() :
+	target(skypeSamplingRate / 10),
+	minimum(skypeSamplingRate / 10),
+	maximum(skypeSamplingRate / 10),
+	current(skypeSamplingRate / 10),
+	adaptive(false)
+{
+}
+
+void BatchPolicy::load(long sampleRate) {
+	minimum = preferences.get(Pref::OutputBatchMin).toInt() * sampleRate / 1000;
+	maximum = preferences.get(Pref::OutputBatchMax).toInt() * sampleRate / 1000;
+	target = preferences.get(Pref::OutputBatchLatency).toInt() * sampleRate / 1000;
+	adaptive = preferences.get(Pref::OutputBatchAdaptive).toBool();
+
+	if (maximum < minimum)
+		maximum = minimum;
+	if (target < minimum)
+		target = minimum;
+	if (target > maximum)
+		target = maximum;
+
+	current = target;
+}
+
+void BatchPolicy::update(int depth) {
+	// depth is the number of blocks waiting in the encoder queue after
+	// queueing the last one.  if anything but that last one is still
+	// waiting, the encoder is falling behind
+
+	if (!adaptive)
+		return;
+
+	if (depth > 1) {
+		current *= 2;
+		if (current > maximum)
+			current = maximum;
+	} else {
+		// keeping up, shrink back a quarter of the way to the configured
+		// latency.  if the encoder has already taken the last block, it
+		// is idle, and the size goes on down to the minimum
+		long floor = depth == 0 ? minimum : target;
+		if (current > floor)
+			current -= (current - floor + 3) / 4;
+	}
+}
+
 // Call class
 
 Call::Call(CallHandler *h, Skype *sk, CallID i) :
@@ -96,37 +222,97 @@ Call::Call(CallHandler *h, Skype *sk, CallID i) :
 	handler(h),
 	id(i),
 	status("UNKNOWN"),
+	confID(0),
+	pendingReplies(0),
 	writer(NULL),
+	encoder(NULL),
 	isRecording(false),
 	shouldRecord(1),
-	sync(100 * 2 * 3, 320) // approx 3 seconds
+	lastClosing(false),
+	sync(100 * 2 * 3, skypeSamplingRate / 10), // approx 3 seconds
+	remotePhase(0.0),
+	remoteRatio(1.0),
+	syncOffset(0.0),
+	consumedLocal(0),
+	consumedRemote(0),
+	serverLocal(NULL),
+	serverRemote(NULL),
+	socketLocal(NULL),
+	socketRemote(NULL)
 {
 	debug(QString("Call %1: Call object contructed").arg(id));
 
+	// the buffers must be able to hold the 20 seconds by which the two
+	// streams may be out of sync (see tryToWrite()), plus some slack
+	bufferLocal.reserve(skypeSamplingRate * 2 * 25);
+	bufferRemote.reserve(skypeSamplingRate * 2 * 25);
+
 	// Call objects track calls even before they are in progress and also
 	// when they are not being recorded.
 
 	// TODO check if we actually should record this call here
 	// and ask if we're unsure
 
-	skypeName = skype->getObject(QString("CALL %1 PARTNER_HANDLE").arg(id));
+	// all requests are sent at once, so they only take one round trip
+	// together.  Skype answers them in order
+
+	pendingReplies = 4;
+
+	SkypeReply *reply = skype->getObjectAsync(QString("CALL %1 PARTNER_HANDLE").arg(id));
+	connect(reply, SIGNAL(finished(const QString &)), this, SLOT(gotPartnerHandle(const QString &)));
+	reply = skype->getObjectAsync(QString("CALL %1 PARTNER_DISPNAME").arg(id));
+	connect(reply, SIGNAL(finished(const QString &)), this, SLOT(gotPartnerDisplayName(const QString &)));
+	reply = skype->getObjectAsync("PROFILE FULLNAME");
+	connect(reply, SIGNAL(finished(const QString &)), this, SLOT(gotMyDisplayName(const QString &)));
+
+	// Skype does not properly send updates when the CONF_ID property
+	// changes.  since we need this information, check it now on all calls
+	handler->updateConfIDs();
+	// this call isn't yet in the list of calls, thus we need to
+	// explicitely check its CONF_ID
+	reply = skype->getObjectAsync(QString("CALL %1 CONF_ID").arg(id));
+	connect(reply, SIGNAL(finished(const QString &)), this, SLOT(gotInitialConfID(const QString &)));
+}
+
+void Call::gotPartnerHandle(const QString &s) {
+	skypeName = s;
 	if (skypeName.isEmpty()) {
 		debug(QString("Call %1: cannot get partner handle").arg(id));
 		skypeName = "UnknownCaller";
 	}
+	setupReplyArrived();
+}
 
-	displayName = skype->getObject(QString("CALL %1 PARTNER_DISPNAME").arg(id));
+void Call::gotPartnerDisplayName(const QString &s) {
+	displayName = s;
 	if (displayName.isEmpty()) {
 		debug(QString("Call %1: cannot get partner display name").arg(id));
 		displayName = "Unnamed Caller";
 	}
+	setupReplyArrived();
+}
 
-	// Skype does not properly send updates when the CONF_ID property
-	// changes.  since we need this information, check it now on all calls
-	handler->updateConfIDs();
-	// this call isn't yet in the list of calls, thus we need to
-	// explicitely check its CONF_ID
-	updateConfID();
+void Call::gotMyDisplayName(const QString &s) {
+	myDisplayName = s;
+	setupReplyArrived();
+}
+
+void Call::gotInitialConfID(const QString &s) {
+	gotConfID(s);
+	setupReplyArrived();
+}
+
+void Call::setupReplyArrived() {
+	if (--pendingReplies > 0)
+		return;
+
+	debug(QString("Call %1: call information complete").arg(id));
+
+	if (!pendingStatus.isEmpty()) {
+		QString s = pendingStatus;
+		pendingStatus.clear();
+		setStatus(s);
+	}
 }
 
 Call::~Call() {
@@ -135,6 +321,10 @@ Call::~Call() {
 	if (isRecording)
 		stopRecording();
 
+	// this waits for the encoders that are still closing files
+	while (!closing.isEmpty())
+		finishClosing(0);
+
 	delete confirmation;
 
 	setStatus("UNKNOWN");
@@ -143,7 +333,12 @@ Call::~Call() {
 }
 
 void Call::updateConfID() {
-	confID = skype->getObject(QString("CALL %1 CONF_ID").arg(id)).toLong();
+	SkypeReply *reply = skype->getObjectAsync(QString("CALL %1 CONF_ID").arg(id));
+	connect(reply, SIGNAL(finished(const QString &)), this, SLOT(gotConfID(const QString &)));
+}
+
+void Call::gotConfID(const QString &s) {
+	confID = s.toLong();
 }
 
 bool Call::okToDelete() const {
@@ -155,6 +350,9 @@ bool Call::okToDelete() const {
 	if (isRecording)
 		return false;
 
+	if (!closing.isEmpty())
+		return false;
+
 	if (confirmation)
 		/* confirmation dialog still open */
 		return false;
@@ -170,6 +368,12 @@ bool Call::statusActive() const {
 }
 
 void Call::setStatus(const QString &s) {
+	if (pendingReplies) {
+		// only the latest status matters once we know who's calling
+		pendingStatus = s;
+		return;
+	}
+
 	bool wasActive = statusActive();
 	status = s;
 	bool nowActive = statusActive();
@@ -195,9 +399,9 @@ bool Call::statusDone() const {
 	// TODO: see what the deal is with REDIAL_PENDING (protocol 8)
 }
 
-QString Call::constructFileName() const {
+QString Call::constructFileName(int segment) const {
 	return getFileName(skypeName, displayName, skype->getSkypeName(),
-		skype->getObject("PROFILE FULLNAME"), timeStartRecording);
+		myDisplayName, timeStartRecording, QString(), segment);
 }
 
 QString Call::constructCommentTag() const {
@@ -205,9 +409,8 @@ QString Call::constructCommentTag() const {
 	QString dn1, dn2;
 	if (!displayName.isEmpty())
 		dn1 = QString(" (") + displayName + ")";
-	dn2 = skype->getObject("PROFILE FULLNAME");
-	if (!dn2.isEmpty())
-		dn2 = QString(" (") + dn2 + ")";
+	if (!myDisplayName.isEmpty())
+		dn2 = QString(" (") + myDisplayName + ")";
 	return str.arg(skypeName, dn1, skype->getSkypeName(), dn2);
 }
 
@@ -271,8 +474,20 @@ void Call::denyRecording() {
 }
 
 void Call::removeFile() {
-	debug(QString("Removing '%1'").arg(fileName));
-	QFile::remove(fileName);
+	// the files of the last recording may still be open on a pool
+	// thread.  they are removed once they are closed, and not transcoded
+	if (lastClosing) {
+		closing.last().remove = true;
+		return;
+	}
+
+	if (!spoolJob.format.isEmpty())
+		TranscodeQueue::instance()->remove(fileName);
+
+	for (int i = 0; i < fileNames.size(); i++) {
+		debug(QString("Removing '%1'").arg(fileNames.at(i)));
+		QFile::remove(fileNames.at(i));
+	}
 }
 
 void Call::startRecording(bool force) {
@@ -301,28 +516,58 @@ void Call::startRecording(bool force) {
 
 	debug(QString("Call %1: start recording").arg(id));
 
+	// earlier recordings may still be closing, but they are on their own
+	lastClosing = false;
+
 	// set up encoder for appropriate format
 
 	timeStartRecording = QDateTime::currentDateTime();
-	QString fn = constructFileName();
+	// long calls may be split into segments, which are named by a
+	// pattern that SegmentingWriter completes
+	int segmentMinutes = preferences.get(Pref::OutputSegmentMinutes).toInt();
+	int segmentSize = preferences.get(Pref::OutputSegmentSize).toInt();
+	bool segmenting = segmentMinutes || segmentSize;
+	QString fn = constructFileName(segmenting ? -1 : 0);
 
 	stereo = preferences.get(Pref::OutputStereo).toBool();
 	stereoMix = preferences.get(Pref::OutputStereoMix).toInt();
 
-	QString format = preferences.get(Pref::OutputFormat).toString();
-
-	if (format == "wav")
+	// extra formats are written alongside by a MultiWriter
+	QStringList formats(preferences.get(Pref::OutputFormat).toString());
+	QStringList extra = preferences.get(Pref::OutputFormatExtra).toList();
+	for (int i = 0; i < extra.size(); i++)
+		if (!formats.contains(extra.at(i)))
+			formats.append(extra.at(i));
+	QString format = formats.join(",");
+	bool saveTags = preferences.get(Pref::OutputSaveTags).toBool();
+
+	// when spooling, the call is written to a WAV file, which costs
+	// almost no CPU, and encoded to the real format after the call.  this
+	// would defeat the point of segments, which are meant to be usable
+	// while the call is still going on
+	spoolJob = TranscodeJob();
+	if (preferences.get(Pref::OutputSpool).toBool() && format != "wav" && !segmenting) {
+		spoolJob.target = fn;
+		spoolJob.format = format;
+		spoolJob.saveTags = saveTags;
+		if (saveTags) {
+			spoolJob.tagComment = constructCommentTag();
+			spoolJob.tagTime = timeStartRecording;
+		}
 		writer = new WaveWriter;
-	else if (format == "mp3")
-		writer = new Mp3Writer;
-	else /*if (format == "vorbis")*/
-		writer = new VorbisWriter;
-
-	if (preferences.get(Pref::OutputSaveTags).toBool())
-		writer->setTags(constructCommentTag(), timeStartRecording);
+	} else {
+		if (segmenting)
+			writer = new SegmentingWriter(format, segmentMinutes * 60, (qint64)segmentSize * 1024 * 1024);
+		else
+			writer = AudioFileWriter::create(format);
+		if (saveTags)
+			writer->setTags(constructCommentTag(), timeStartRecording);
+	}
 
-	bool b = writer->open(fn, skypeSamplingRate, stereo);
+	bool b = writer->open(spoolJob.format.isEmpty() ? fn : fn + ".spool", skypeSamplingRate, stereo);
 	fileName = writer->fileName();
+	fileNames = writer->fileNames();
+	spoolJob.spoolFile = fileName;
 
 	if (!b) {
 		QMessageBox *box = new QMessageBox(QMessageBox::Critical, PROGRAM_NAME " - Error",
@@ -335,98 +580,124 @@ void Call::startRecording(bool force) {
 		return;
 	}
 
-	serverLocal = new QTcpServer(this);
+	serverLocal = new AudioServer(this);
 	serverLocal->listen();
 	connect(serverLocal, SIGNAL(newConnection()), this, SLOT(acceptLocal()));
-	serverRemote = new QTcpServer(this);
+	serverRemote = new AudioServer(this);
 	serverRemote->listen();
 	connect(serverRemote, SIGNAL(newConnection()), this, SLOT(acceptRemote()));
 
-	QString rep1 = skype->sendWithReply(QString("ALTER CALL %1 SET_CAPTURE_MIC PORT=\"%2\"").arg(id).arg(serverLocal->serverPort()));
-	QString rep2 = skype->sendWithReply(QString("ALTER CALL %1 SET_OUTPUT SOUNDCARD=\"default\" PORT=\"%2\"").arg(id).arg(serverRemote->serverPort()));
-
-	if (!rep1.startsWith("ALTER CALL ") || !rep2.startsWith("ALTER CALL")) {
-		QMessageBox *box = new QMessageBox(QMessageBox::Critical, PROGRAM_NAME " - Error",
-			QString(PROGRAM_NAME " could not obtain the audio streams from Skype and can thus not record this call.\n\n"
-			"The replies from Skype were:\n%1\n%2").arg(rep1, rep2));
-		box->setWindowModality(Qt::NonModal);
-		box->setAttribute(Qt::WA_DeleteOnClose);
-		box->show();
-		removeFile();
-		delete writer;
-		delete serverRemote;
-		delete serverLocal;
-		return;
-	}
+	// both requests are in flight at once.  if Skype refuses one of them,
+	// the recording is abandoned when the reply arrives, see
+	// gotAlterReply()
+	alterRequests.clear();
+	alterErrors.clear();
+	SkypeReply *reply = skype->sendAsync(QString("ALTER CALL %1 SET_CAPTURE_MIC PORT=\"%2\"").arg(id).arg(serverLocal->serverPort()));
+	connect(reply, SIGNAL(finished(const QString &)), this, SLOT(gotAlterReply(const QString &)));
+	alterRequests.append(reply);
+	reply = skype->sendAsync(QString("ALTER CALL %1 SET_OUTPUT SOUNDCARD=\"default\" PORT=\"%2\"").arg(id).arg(serverRemote->serverPort()));
+	connect(reply, SIGNAL(finished(const QString &)), this, SLOT(gotAlterReply(const QString &)));
+	alterRequests.append(reply);
 
 	if (preferences.get(Pref::DebugWriteSyncFile).toBool()) {
-		syncFile.setFileName(fn + ".sync");
+		syncFile.setFileName((segmenting ? getSegmentFileName(fn, 0) : fn) + ".sync");
 		syncFile.open(QIODevice::WriteOnly);
 		syncTime.start();
 	}
 
+	batch.load(skypeSamplingRate);
+
+	sync.reset();
+	drift.reset();
+	remotePhase = 0.0;
+	remoteRatio = 1.0;
+	syncOffset = 0.0;
+	consumedLocal = consumedRemote = 0;
+
+	encoder = new Encoder(writer, id);
+	connect(encoder, SIGNAL(failed()), this, SLOT(encoderFailed()));
+	connect(encoder, SIGNAL(finished()), this, SLOT(encoderFinished()));
+	connect(encoder, SIGNAL(outputFailed(const QStringList &)), this, SLOT(outputFailed(const QStringList &)));
+
 	isRecording = true;
 	emit startedRecording(id);
 }
 
+void Call::gotAlterReply(const QString &s) {
+	// replies for an earlier recording don't matter anymore
+	int i = alterRequests.indexOf(sender());
+	if (i < 0)
+		return;
+	alterRequests.removeAt(i);
+
+	if (!s.startsWith("ALTER CALL "))
+		alterErrors.append(s.isEmpty() ? QString("(no reply)") : s);
+
+	if (!alterRequests.isEmpty() || alterErrors.isEmpty() || !isRecording)
+		return;
+
+	QMessageBox *box = new QMessageBox(QMessageBox::Critical, PROGRAM_NAME " - Error",
+		QString(PROGRAM_NAME " could not obtain the audio streams from Skype and can thus not record this call.\n\n"
+		"The replies from Skype were:\n%1").arg(alterErrors.join("\n")));
+	box->setWindowModality(Qt::NonModal);
+	box->setAttribute(Qt::WA_DeleteOnClose);
+	box->show();
+	stopRecording(false);
+	removeFile();
+
+	// Skype won't connect to the servers anymore.  unlike in
+	// stopRecording(), we are not in a signal of their sockets here, so
+	// they can go right away, sockets included
+	delete serverLocal;
+	delete serverRemote;
+	serverLocal = serverRemote = NULL;
+	socketLocal = socketRemote = NULL;
+}
+
 void Call::acceptLocal() {
-	socketLocal = serverLocal->nextPendingConnection();
+	socketLocal = serverLocal->nextPendingStream();
 	serverLocal->close();
+	if (!socketLocal)
+		return;
 	// we don't delete the server, since it contains the socket.
 	// we could reparent, but that automatic stuff of QT is great
+	socketLocal->setBuffer(&bufferLocal);
 	connect(socketLocal, SIGNAL(readyRead()), this, SLOT(readLocal()));
 	connect(socketLocal, SIGNAL(disconnected()), this, SLOT(checkConnections()));
 }
 
 void Call::acceptRemote() {
-	socketRemote = serverRemote->nextPendingConnection();
+	socketRemote = serverRemote->nextPendingStream();
 	serverRemote->close();
+	if (!socketRemote)
+		return;
+	socketRemote->setBuffer(&bufferRemote);
 	connect(socketRemote, SIGNAL(readyRead()), this, SLOT(readRemote()));
 	connect(socketRemote, SIGNAL(disconnected()), this, SLOT(checkConnections()));
 }
 
 void Call::readLocal() {
-	bufferLocal += socketLocal->readAll();
+	// the data has already been read into bufferLocal
 	if (isRecording)
 		tryToWrite();
 }
 
 void Call::readRemote() {
-	bufferRemote += socketRemote->readAll();
+	// the data has already been read into bufferRemote
 	if (isRecording)
 		tryToWrite();
 }
 
 void Call::checkConnections() {
-	if (socketLocal->state() == QAbstractSocket::UnconnectedState && socketRemote->state() == QAbstractSocket::UnconnectedState) {
+	bool localOpen = socketLocal && socketLocal->isOpen();
+	bool remoteOpen = socketRemote && socketRemote->isOpen();
+
+	if (!localOpen && !remoteOpen) {
 		debug(QString("Call %1: both connections closed, stop recording").arg(id));
 		stopRecording();
 	}
 }
 
-void Call::mixToMono(long samples) {
-	qint16 *localData = reinterpret_cast<qint16 *>(bufferLocal.data());
-	qint16 *remoteData = reinterpret_cast<qint16 *>(bufferRemote.data());
-
-	for (long i = 0; i < samples; i++)
-		localData[i] = ((qint32)localData[i] + (qint32)remoteData[i]) / (qint32)2;
-}
-
-void Call::mixToStereo(long samples, int pan) {
-	qint16 *localData = reinterpret_cast<qint16 *>(bufferLocal.data());
-	qint16 *remoteData = reinterpret_cast<qint16 *>(bufferRemote.data());
-
-	qint32 fl = 100 - pan;
-	qint32 fr = pan;
-
-	for (long i = 0; i < samples; i++) {
-		qint16 newLocal = ((qint32)localData[i] * fl + (qint32)remoteData[i] * fr + (qint32)50) / (qint32)100;
-		qint16 newRemote = ((qint32)localData[i] * fr + (qint32)remoteData[i] * fl + (qint32)50) / (qint32)100;
-		localData[i] = newLocal;
-		remoteData[i] = newRemote;
-	}
-}
-
 long Call::padBuffers() {
 	// pads the shorter buffer with silence, so they are both the same
 	// length afterwards.  returns the new number of samples in each buffer
@@ -436,12 +707,14 @@ long Call::padBuffers() {
 
 	if (l < r) {
 		long amount = r - l;
-		bufferLocal.append(QByteArray(amount, 0));
+		bufferLocal.appendSilence(amount);
+		drift.restart();
 		debug(QString("Call %1: padding %2 samples on local buffer").arg(id).arg(amount / 2));
 		return r / 2;
 	} else if (l > r) {
 		long amount = l - r;
-		bufferRemote.append(QByteArray(amount, 0));
+		bufferRemote.appendSilence(amount);
+		drift.restart();
 		debug(QString("Call %1: padding %2 samples on remote buffer").arg(id).arg(amount / 2));
 		return l / 2;
 	}
@@ -450,15 +723,54 @@ long Call::padBuffers() {
 }
 
 void Call::doSync(long s) {
+	drift.restart();
+
 	if (s > 0) {
-		bufferLocal.append(QByteArray(s * 2, 0));
+		bufferLocal.appendSilence(s * 2);
 		debug(QString("Call %1: padding %2 samples on local buffer").arg(id).arg(s));
 	} else {
-		bufferRemote.append(QByteArray(s * -2, 0));
+		bufferRemote.appendSilence(s * -2);
 		debug(QString("Call %1: padding %2 samples on remote buffer").arg(id).arg(-s));
 	}
 }
 
+long Call::remoteSamplesAvailable() const {
+	// the number of output samples that can be interpolated from the
+	// remote buffer at the current phase and ratio.  the last one needs
+	// the sample after it as well
+
+	double room = (double)(bufferRemote.size() / 2 - 2) - remotePhase;
+	if (room < 0.0)
+		return 0;
+	return (long)(room / remoteRatio) + 1;
+}
+
+void Call::resampleRemote(long samples) {
+	// linear interpolation of the remote stream into resampled, which
+	// consumes samples * remoteRatio remote samples.  the fractional
+	// remainder is carried over to the next block, so there are no
+	// discontinuities at the block boundaries
+
+	resampled.resize(samples * 2);
+	qint16 *output = reinterpret_cast<qint16 *>(resampled.data());
+
+	for (long i = 0; i < samples; i++) {
+		double pos = remotePhase + (double)i * remoteRatio;
+		long k = (long)pos;
+		double f = pos - (double)k;
+		qint32 a = bufferRemote.sampleAt(k);
+		qint32 b = bufferRemote.sampleAt(k + 1);
+		output[i] = (qint16)std::floor((double)a + f * (double)(b - a) + 0.5);
+	}
+
+	double end = remotePhase + (double)samples * remoteRatio;
+	long consumed = (long)end;
+	remotePhase = end - (double)consumed;
+
+	bufferRemote.consume(consumed * 2);
+	consumedRemote += consumed;
+}
+
 void Call::tryToWrite(bool flush) {
 	//debug(QString("Situation: %3, %4").arg(bufferLocal.size()).arg(bufferRemote.size()));
 
@@ -469,12 +781,25 @@ void Call::tryToWrite(bool flush) {
 		// available data is written.  this shouldn't usually be a
 		// significant amount, but it might be if there was an audio
 		// I/O error in Skype.
-		samples = padBuffers();
+		padBuffers();
+		samples = qMin(bufferLocal.size() / 2, remoteSamplesAvailable());
 	} else {
 		long l = bufferLocal.size() / 2;
 		long r = bufferRemote.size() / 2;
 
-		sync.add(r - l);
+		// the streams are kept aligned by resampling the remote one.
+		// its ratio follows the estimated clock drift, plus a small
+		// correction that pulls the difference in buffered samples
+		// towards zero within about 10 seconds.  the difference jumps
+		// by a packet whenever one arrives, hence the smoothing.  big
+		// jumps, where one stream has lost a lot of data, can't be
+		// corrected like this in a reasonable amount of time; they
+		// are padded with silence as before
+
+		double offset = (double)r - remotePhase - (double)l;
+		syncOffset += (offset - syncOffset) / 64.0;
+
+		sync.add((long)offset);
 
 		long syncAmount = sync.getSync();
 		syncAmount = (syncAmount / 160) * 160;
@@ -482,72 +807,156 @@ void Call::tryToWrite(bool flush) {
 		if (syncAmount) {
 			doSync(syncAmount);
 			sync.reset();
+			syncOffset -= (double)syncAmount;
 			l = bufferLocal.size() / 2;
 			r = bufferRemote.size() / 2;
+		} else if (std::fabs(offset) < (double)skypeSamplingRate / 20.0) {
+			// the drift is only estimated while the streams are
+			// roughly aligned, so that dropouts don't disturb it
+			double x = (double)(consumedLocal + l);
+			drift.add(x, (double)(consumedRemote + r) - x);
 		}
 
+		remoteRatio = 1.0 + drift.drift() + syncOffset / (double)(skypeSamplingRate * 10);
+		if (remoteRatio > 1.005)
+			remoteRatio = 1.005;
+		if (remoteRatio < 0.995)
+			remoteRatio = 0.995;
+
 		if (syncFile.isOpen())
-			syncFile.write(QString("%1 %2 %3\n").arg(syncTime.elapsed()).arg(r - l).arg(syncAmount).toAscii().constData());
+			syncFile.write(QString("%1 %2 %3 %4\n").arg(syncTime.elapsed()).arg(r - l).arg(syncAmount).arg(remoteRatio, 0, 'f', 6).toAscii().constData());
 
 		if (std::labs(r - l) > skypeSamplingRate * 20) {
 			// more than 20 seconds out of sync, something went
 			// wrong.  avoid eating memory by accumulating data
 			long s = (r - l) / skypeSamplingRate;
 			debug(QString("Call %1: WARNING: seriously out of sync by %2s; padding").arg(id).arg(s));
-			samples = padBuffers();
+			padBuffers();
 			sync.reset();
-		} else {
-			samples = l < r ? l : r;
-
-			// skype usually sends new PCM data every 10ms (160
-			// samples at 16kHz).  let's accumulate at least 100ms
-			// of data before bothering to write it to disk
-			if (samples < skypeSamplingRate / 10)
-				return;
+			syncOffset = 0.0;
 		}
+
+		samples = qMin(bufferLocal.size() / 2, remoteSamplesAvailable());
+
+		// skype usually sends new PCM data every 10ms (160 samples at
+		// 16kHz).  let's accumulate a decent block of data (100ms by
+		// default) before bothering to encode it and write it to disk
+		if (samples < batch.size())
+			return;
 	}
 
 	// got new samples to write to file, or have to flush.  note that we
-	// have to flush even if samples == 0
-
-	bool success;
-
-	if (!stereo) {
-		// mono
-		mixToMono(samples);
-		QByteArray dummy;
-		success = writer->write(bufferLocal, dummy, samples, flush);
-		bufferRemote.remove(0, samples * 2);
-	} else if (stereoMix == 0) {
-		// local left, remote right
-		success = writer->write(bufferLocal, bufferRemote, samples, flush);
-	} else if (stereoMix == 100) {
-		// local right, remote left
-		success = writer->write(bufferRemote, bufferLocal, samples, flush);
-	} else {
-		mixToStereo(samples, stereoMix);
-		success = writer->write(bufferLocal, bufferRemote, samples, flush);
+	// have to flush even if samples == 0.  the samples are mixed into a
+	// block which is then handed to the encoder thread.  if its queue is
+	// full, leave the data in our buffers and try again later, unless
+	// we're flushing
+
+	PcmBlock *block = encoder->getBlock(flush);
+	if (!block) {
+		batch.update(encoder->queueCapacity());
+		return;
 	}
 
-	if (!success) {
-		QMessageBox *box = new QMessageBox(QMessageBox::Critical, PROGRAM_NAME " - Error",
-			QString(PROGRAM_NAME " encountered an error while writing this call to disk.  Recording terminated."));
-		box->setWindowModality(Qt::NonModal);
-		box->setAttribute(Qt::WA_DeleteOnClose);
-		box->show();
-		stopRecording(false);
-		return;
+	resampleRemote(samples);
+	const qint16 *remoteData = reinterpret_cast<const qint16 *>(resampled.constData());
+
+	block->resize(samples, stereo);
+	qint16 *left = samples ? block->leftData() : NULL;
+	qint16 *right = samples && stereo ? block->rightData() : NULL;
+
+	// the local data may wrap around the end of its ring buffer, in
+	// which case it is processed in pieces
+	long done = 0;
+
+	while (done < samples) {
+		long chunk = samples - done;
+		if (chunk > bufferLocal.readSize() / 2)
+			chunk = bufferLocal.readSize() / 2;
+
+		const qint16 *localData = reinterpret_cast<const qint16 *>(bufferLocal.readPointer());
+
+		if (stereo)
+			mixToStereo(left + done, right + done, localData, remoteData + done, chunk, stereoMix);
+		else
+			mixToMono(left + done, localData, remoteData + done, chunk);
+
+		bufferLocal.consume(chunk * 2);
+		done += chunk;
 	}
 
-	// the writer will remove the samples from the buffers
+	consumedLocal += samples;
+
+	encoder->putBlock(flush);
+	batch.update(encoder->queueDepth());
+
 	//debug(QString("Call %1: wrote %2 samples").arg(id).arg(samples));
+}
 
-	// TODO: handle the case where the two streams get out of sync (buffers
-	// not equally fulled by a significant amount).  does skype document
-	// whether we always get two nice, equal, in-sync streams, even if
-	// there have been transmission errors?  perl-script behavior: if out
-	// of sync by more than 6.4ms, then remove 1ms from the stream that's
-	// ahead.
+void Call::encoderFailed() {
+	// an earlier recording that is still closing its files
+	if (sender() != encoder)
+		return;
+
+	QMessageBox *box = new QMessageBox(QMessageBox::Critical, PROGRAM_NAME " - Error",
+		QString(PROGRAM_NAME " encountered an error while writing this call to disk.  Recording terminated."));
+	box->setWindowModality(Qt::NonModal);
+	box->setAttribute(Qt::WA_DeleteOnClose);
+	box->show();
+	stopRecording(false);
+}
+
+void Call::encoderFinished() {
+	for (int i = 0; i < closing.size(); i++) {
+		if (closing.at(i).encoder == sender()) {
+			finishClosing(i);
+			break;
+		}
+	}
+
+	// the CallHandler may delete us now
+	emit closedFiles();
+}
+
+void Call::finishClosing(int i) {
+	Closing c = closing.takeAt(i);
+	bool last = lastClosing && i == closing.size();
+
+	// normally the encoder is done, otherwise this waits for it
+	delete c.encoder;
+	QStringList names = c.writer->fileNames();
+	delete c.writer;
+
+	if (last) {
+		// segments may have been added during the call
+		fileNames = names;
+		lastClosing = false;
+	}
+
+	if (c.remove) {
+		for (int j = 0; j < names.size(); j++) {
+			debug(QString("Removing '%1'").arg(names.at(j)));
+			QFile::remove(names.at(j));
+		}
+	} else if (!c.spoolJob.format.isEmpty()) {
+		TranscodeQueue::instance()->add(c.spoolJob);
+	}
+}
+
+void Call::outputFailed(const QStringList &lost) {
+	// one of several formats could not be written.  the others are still
+	// being recorded, and the incomplete files of this one are of no use
+	for (int i = 0; i < lost.size(); i++) {
+		debug(QString("Call %1: removing '%2'").arg(id).arg(lost.at(i)));
+		QFile::remove(lost.at(i));
+		fileNames.removeAll(lost.at(i));
+	}
+
+	QMessageBox *box = new QMessageBox(QMessageBox::Warning, PROGRAM_NAME " - Error",
+		QString(PROGRAM_NAME " encountered an error while writing the file %1 and removed it.  "
+		"The call is still being recorded in the other formats.").arg(lost.first()));
+	box->setWindowModality(Qt::NonModal);
+	box->setAttribute(Qt::WA_DeleteOnClose);
+	box->show();
 }
 
 void Call::stopRecording(bool flush) {
@@ -565,11 +974,27 @@ void Call::stopRecording(bool flush) {
 	// times, but unless you do it thousands of times, the waste is more
 	// than acceptable.
 
-	// flush data to writer
+	// flush data to the writer.  the encoder then closes the files on a
+	// pool thread, so that the tail of the encoding and the final sync
+	// don't hold up the GUI.  encoderFinished() takes it from there
 	if (flush)
 		tryToWrite(true);
-	writer->close();
-	delete writer;
+	Closing c;
+	c.encoder = encoder;
+	c.writer = writer;
+	c.spoolJob = spoolJob;
+	c.remove = false;
+	closing.append(c);
+	lastClosing = true;
+	encoder->finish();
+	encoder = NULL;
+	writer = NULL;
+
+	debug(QString("Call %1: estimated clock drift of remote stream: %2 ppm").arg(id).arg(drift.drift() * 1e6, 0, 'f', 1));
+
+	// whatever is left over was not meant to be recorded
+	bufferLocal.clear();
+	bufferRemote.clear();
 
 	if (syncFile.isOpen())
 		syncFile.close();
@@ -577,10 +1002,18 @@ void Call::stopRecording(bool flush) {
 	// we must disconnect all signals from the sockets first, so that upon
 	// closing them it won't call checkConnections() and we don't land here
 	// recursively again
-	disconnect(socketLocal, 0, this, 0);
-	disconnect(socketRemote, 0, this, 0);
-	socketLocal->close();
-	socketRemote->close();
+	if (socketLocal) {
+		debug(QString("Call %1: local stream: %2 bytes in %3 packets").arg(id)
+			.arg(socketLocal->bytesReceived()).arg(socketLocal->packetsReceived()));
+		disconnect(socketLocal, 0, this, 0);
+		socketLocal->close();
+	}
+	if (socketRemote) {
+		debug(QString("Call %1: remote stream: %2 bytes in %3 packets").arg(id)
+			.arg(socketRemote->bytesReceived()).arg(socketRemote->packetsReceived()));
+		disconnect(socketRemote, 0, this, 0);
+		socketRemote->close();
+	}
 
 	isRecording = false;
 	emit stoppedRecording(id);
@@ -644,6 +1077,8 @@ void CallHandler::callCmd(const QStringList &args) {
 		connect(call, SIGNAL(startedRecording(int)),             this, SIGNAL(startedRecording(int)));
 		connect(call, SIGNAL(stoppedRecording(int)),             this, SIGNAL(stoppedRecording(int)));
 		connect(call, SIGNAL(showLegalInformation()),            this, SLOT(showLegalInformation()));
+		// not right away, since the call emits this from one of its slots
+		connect(call, SIGNAL(closedFiles()), this, SLOT(prune()), Qt::QueuedConnection);
 	}
 
 	QString subCmd = args.at(1);
@@ -26,6 +26,8 @@
 
 #include <QObject>
 #include <QString>
+#include <QStringList>
+#include <QList>
 #include <QByteArray>
 #include <QMap>
 #include <QSet>
@@ -35,12 +37,15 @@
 #include <QFile>
 
 #include "common.h"
+#include "ringbuffer.h"
+#include "transcoder.h"
 
 class QStringList;
 class Skype;
 class AudioFileWriter;
-class QTcpServer;
-class QTcpSocket;
+class Encoder;
+class AudioServer;
+class AudioStream;
 class LegalInformationDialog;
 
 class CallHandler;
@@ -67,6 +72,51 @@ private:
 	DISABLE_COPY_AND_ASSIGNMENT(AutoSync);
 };
 
+// DriftEstimator - estimates by how much the sample clocks of the two streams
+// differ, from a running linear regression of the difference in received
+// samples against the number of local samples received
+
+class DriftEstimator {
+public:
+	DriftEstimator();
+	void reset();
+	// forgets where the line is, but keeps its slope
+	void restart();
+	void add(double, double);
+	double drift() const;
+
+private:
+	double meanX;
+	double meanY;
+	double varX;
+	double covXY;
+	long count;
+	bool restarting;
+
+	DISABLE_COPY_AND_ASSIGNMENT(DriftEstimator);
+};
+
+// BatchPolicy - decides how many samples to accumulate before handing them
+// to the encoder.  larger blocks mean less overhead per sample, smaller ones
+// mean less latency
+
+class BatchPolicy {
+public:
+	BatchPolicy();
+	void load(long);
+	long size() const { return current; }
+	void update(int);
+
+private:
+	long target;
+	long minimum;
+	long maximum;
+	long current;
+	bool adaptive;
+
+	DISABLE_COPY_AND_ASSIGNMENT(BatchPolicy);
+};
+
 class Call : public QObject {
 	Q_OBJECT
 public:
@@ -91,16 +141,20 @@ signals:
 	void stoppedCall(int);
 	void startedRecording(int);
 	void stoppedRecording(int);
+	// the files of a stopped recording have been closed
+	void closedFiles();
 	void showLegalInformation();
 
 private:
-	QString constructFileName() const;
+	QString constructFileName(int = 0) const;
 	QString constructCommentTag() const;
-	void mixToMono(long);
-	void mixToStereo(long, int);
+	void setupReplyArrived();
 	void setShouldRecord();
 	void ask();
 	void doSync(long);
+	long remoteSamplesAvailable() const;
+	void resampleRemote(long);
+	void finishClosing(int);
 
 private:
 	Skype *skype;
@@ -109,23 +163,61 @@ private:
 	QString status;
 	QString skypeName;
 	QString displayName;
+	QString myDisplayName;
 	CallID confID;
+	// the information above is requested all at once when the call is
+	// constructed.  status changes wait until all of it has arrived
+	int pendingReplies;
+	QString pendingStatus;
+	// the ALTER CALL requests of the current recording, and the replies
+	// that were not successful
+	QList<QObject *> alterRequests;
+	QStringList alterErrors;
 	AudioFileWriter *writer;
+	Encoder *encoder;
 	bool isRecording;
 	int stereo;
 	int stereoMix;
 	int shouldRecord;
 	QString fileName;
+	// all files being written, when there are extra formats
+	QStringList fileNames;
 	QPointer<QObject> confirmation;
 	QDateTime timeStartRecording;
+	// when spooling, the format is set and the job is queued once the
+	// recording stops
+	TranscodeJob spoolJob;
+
+	// stopped recordings whose files are still being closed by their
+	// encoder on a pool thread, see encoderFinished().  removeFile() can
+	// only mark the last recording for removal while it is in here
+	struct Closing {
+		Encoder *encoder;
+		AudioFileWriter *writer;
+		TranscodeJob spoolJob;
+		bool remove;
+	};
+	QList<Closing> closing;
+	bool lastClosing;
 
 	QTime syncTime;
 	QFile syncFile;
 	AutoSync sync;
+	DriftEstimator drift;
+	BatchPolicy batch;
+
+	// state of the resampling of the remote stream.  remotePhase is the
+	// fractional position between the first two samples in bufferRemote,
+	// remoteRatio the number of remote samples consumed per local one
+	double remotePhase;
+	double remoteRatio;
+	double syncOffset;
+	qint64 consumedLocal, consumedRemote;
+	QByteArray resampled;
 
-	QTcpServer *serverLocal, *serverRemote;
-	QTcpSocket *socketLocal, *socketRemote;
-	QByteArray bufferLocal, bufferRemote;
+	AudioServer *serverLocal, *serverRemote;
+	AudioStream *socketLocal, *socketRemote;
+	RingBuffer bufferLocal, bufferRemote;
 
 private slots:
 	void acceptLocal();
@@ -135,8 +227,17 @@ private slots:
 	void checkConnections();
 	long padBuffers();
 	void tryToWrite(bool = false);
+	void encoderFailed();
+	void encoderFinished();
+	void outputFailed(const QStringList &);
 	void confirmRecording();
 	void denyRecording();
+	void gotPartnerHandle(const QString &);
+	void gotPartnerDisplayName(const QString &);
+	void gotMyDisplayName(const QString &);
+	void gotInitialConfID(const QString &);
+	void gotConfID(const QString &);
+	void gotAlterReply(const QString &);
 
 private: // moc gets confused without this private:
 	DISABLE_COPY_AND_ASSIGNMENT(Call);
@@ -167,8 +268,6 @@ public slots:
 
 private slots:
 	void showLegalInformation();
-
-private:
 	void prune();
 
 private:
@@ -21,16 +21,25 @@
 	http://www.fsf.org/
 */
 
+#include <QMutex>
+#include <QMutexLocker>
+
 #include "common.h"
 #include "recorder.h"
 
 Recorder *recorderInstance = NULL;
 
+namespace {
+// debug() may be called from encoder threads too
+QMutex debugMutex;
+}
+
 const char *const websiteURL = "http://atdot.ch/scr/";
 const char *const donateURL = "https://goo.gl/qhIeEN";
 const char *const flattrURL = "https://goo.gl/LzNn7V";
 
 void debug(const QString &s) {
+	QMutexLocker locker(&debugMutex);
 	if (recorderInstance)
 		recorderInstance->debugMessage(s);
 }
@@ -0,0 +1,49 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+#ifndef CPU_H
+#define CPU_H
+
+// Run time detection of x86 vector extensions.  code using them is compiled
+// with __attribute__((target(...))) on the respective functions, so the rest
+// of the program still runs on CPUs without them.  the intrinsics headers
+// only allow that from gcc 4.9 on
+
+#if (defined(__i386__) || defined(__x86_64__)) && \
+	(defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define HAVE_X86_SIMD
+#include <immintrin.h>
+
+inline bool cpuHasSSE2() {
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("sse2");
+}
+
+inline bool cpuHasAVX2() {
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+}
+#endif
+
+#endif
+
@@ -0,0 +1,416 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+#include <QString>
+#include <QTime>
+#include <QMutexLocker>
+#include <ctime>
+
+#include "encoder.h"
+#include "common.h"
+#include "writer.h"
+
+namespace {
+// number of blocks that can be queued.  with the usual block size of 100ms,
+// this lets the encoder fall behind by about six seconds before the capture
+// side has to keep the data in its own buffers
+const int queueSize = 64;
+
+// number of blocks an encoder may process before it has to give other
+// encoders a chance to run
+const int blocksPerRun = 8;
+}
+
+// PcmBlock
+
+void PcmBlock::resize(long s, bool stereo) {
+	samples = s;
+	left.resize(s * 2);
+	right.resize(stereo ? s * 2 : 0);
+}
+
+// PcmQueue
+
+PcmQueue::PcmQueue(int s) :
+	size(s),
+	head(0),
+	tail(0)
+{
+	blocks = new PcmBlock[size];
+}
+
+PcmQueue::~PcmQueue() {
+	delete[] blocks;
+}
+
+PcmBlock *PcmQueue::back() {
+	// only the producer modifies tail, so it can read it directly
+	int t = tail;
+	if ((t + 1) % size == head.fetchAndAddAcquire(0))
+		return NULL;
+	return &blocks[t];
+}
+
+void PcmQueue::push() {
+	int t = tail;
+	tail.fetchAndStoreRelease((t + 1) % size);
+}
+
+PcmBlock *PcmQueue::front() {
+	// only the consumer modifies head, so it can read it directly
+	int h = head;
+	if (h == tail.fetchAndAddAcquire(0))
+		return NULL;
+	return &blocks[h];
+}
+
+void PcmQueue::pop() {
+	int h = head;
+	head.fetchAndStoreRelease((h + 1) % size);
+}
+
+int PcmQueue::depth() {
+	int d = tail.fetchAndAddAcquire(0) - head.fetchAndAddAcquire(0);
+	return d < 0 ? d + size : d;
+}
+
+// Encoder
+
+Encoder::Encoder(AudioFileWriter *w, int i) :
+	writer(w),
+	id(i),
+	queue(queueSize),
+	current(NULL),
+	scheduled(0),
+	hasEnded(false),
+	isFinished(false),
+	hasFailed(false),
+	blocks(0),
+	samples(0),
+	maxDepth(0),
+	busyTime(0),
+	cpuTime(0),
+	warnedFull(false)
+{
+}
+
+Encoder::~Encoder() {
+	// normally, finished() has already been emitted and none of this
+	// waits for long
+	finish();
+
+	{
+		QMutexLocker locker(&finishMutex);
+		while (!isFinished)
+			finishCondition.wait(&finishMutex);
+	}
+
+	// the pool thread may still be on its way out of process()
+	EncoderPool::instance()->release(this);
+}
+
+PcmBlock *Encoder::getBlock(bool wait) {
+	current = queue.back();
+
+	while (!current && wait) {
+		// announce that we're going to sleep, so that the consumer
+		// wakes us up after its next pop().  we must check the queue
+		// again after the announcement, since the consumer may have
+		// popped before it saw it.  the timeout is merely a safety net
+		producerSleeping.fetchAndStoreOrdered(1);
+		current = queue.back();
+		if (!current)
+			producerWakeup.tryAcquire(1, 100);
+	}
+
+	if (!current && !warnedFull) {
+		debug(QString("Call %1: WARNING: encoder queue is full, encoder is falling behind").arg(id));
+		warnedFull = true;
+	}
+
+	return current;
+}
+
+void Encoder::putBlock(bool flush) {
+	current->flush = flush;
+	current->end = false;
+	current = NULL;
+	queue.push();
+
+	int depth = queue.depth();
+	if (depth > maxDepth)
+		maxDepth = depth;
+
+	if (scheduled.testAndSetOrdered(0, 1))
+		EncoderPool::instance()->submit(this);
+}
+
+void Encoder::finish() {
+	if (hasEnded)
+		return;
+	hasEnded = true;
+
+	getBlock(true);
+	current->resize(0, false);
+	current->flush = false;
+	current->end = true;
+	current = NULL;
+	queue.push();
+
+	if (scheduled.testAndSetOrdered(0, 1))
+		EncoderPool::instance()->submit(this);
+}
+
+namespace {
+int threadCpuTime() {
+	struct timespec ts;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+		return 0;
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+}
+
+void Encoder::process() {
+	// this runs on a pool thread.  process a limited number of blocks, so
+	// that other recordings get their turn too
+
+	QTime timer;
+
+	for (int i = 0; i < blocksPerRun; i++) {
+		PcmBlock *block = queue.front();
+
+		if (!block)
+			break;
+
+		if (block->end) {
+			queue.pop();
+			writer->close();
+
+			debug(QString("Call %1: encoder done, %2 blocks, %3 samples, max queue depth %4/%5, busy %6 ms, cpu %7 ms")
+				.arg(id).arg(blocks).arg(samples).arg(maxDepth).arg(queue.capacity()).arg(busyTime).arg(cpuTime));
+
+			{
+				QMutexLocker locker(&finishMutex);
+				isFinished = true;
+				finishCondition.wakeAll();
+			}
+
+			// the producer may delete us from now on, but its
+			// destructor waits until we're out of here
+			emit finished();
+			return;
+		}
+
+		// after a failure, keep draining the queue so the producer
+		// doesn't get stuck, but don't bother the writer anymore
+		if (!hasFailed) {
+			timer.start();
+			int cpu = threadCpuTime();
+			bool ok = writer->write(block->samples ? block->leftData() : NULL,
+				block->right.isEmpty() ? NULL : block->rightData(), block->samples, block->flush);
+			cpuTime += threadCpuTime() - cpu;
+			busyTime += timer.elapsed();
+
+			QStringList lost = writer->takeLostFileNames();
+			if (!lost.isEmpty())
+				emit outputFailed(lost);
+
+			if (!ok) {
+				hasFailed = true;
+				emit failed();
+			}
+		}
+
+		blocks++;
+		samples += block->samples;
+
+		queue.pop();
+		if (producerSleeping.testAndSetOrdered(1, 0))
+			producerWakeup.release();
+	}
+
+	// we're done for now.  if the producer has queued more blocks in the
+	// meantime, it may not have scheduled us, since we still were, so we
+	// have to check for that after unscheduling.  as soon as we're
+	// unscheduled, finish() may queue the end block and another pool
+	// thread may process it.  holding finishMutex keeps that thread from
+	// setting isFinished until we're done here, and the destructor waits
+	// for this thread to be out of process() anyway
+	QMutexLocker locker(&finishMutex);
+	scheduled.fetchAndStoreOrdered(0);
+	if (queue.front() && scheduled.testAndSetOrdered(0, 1))
+		EncoderPool::instance()->submit(this);
+}
+
+// EncoderPoolThread
+
+class EncoderPoolThread : public QThread {
+public:
+	EncoderPoolThread(EncoderPool *p, int i) : pool(p), index(i) { }
+
+protected:
+	void run() {
+		Encoder *encoder = NULL;
+		while ((encoder = pool->take(index, encoder)))
+			encoder->process();
+	}
+
+private:
+	EncoderPool *pool;
+	int index;
+};
+
+// EncoderPool
+
+EncoderPool *EncoderPool::pool = NULL;
+
+EncoderPool *EncoderPool::instance() {
+	// the pool is created by the GUI thread when the first recording
+	// starts, before any pool thread can ask for it
+	if (!pool)
+		pool = new EncoderPool;
+	return pool;
+}
+
+void EncoderPool::destroy() {
+	delete pool;
+	pool = NULL;
+}
+
+EncoderPool::EncoderPool() :
+	next(0),
+	pending(0),
+	quitting(false),
+	runs(0),
+	steals(0)
+{
+	size = QThread::idealThreadCount();
+	if (size < 1)
+		size = 1;
+
+	queues = new WorkQueue[size];
+
+	for (int i = 0; i < size; i++) {
+		QThread *thread = new EncoderPoolThread(this, i);
+		threads.append(thread);
+		thread->start();
+	}
+
+	debug(QString("Encoder pool started with %1 threads").arg(size));
+}
+
+EncoderPool::~EncoderPool() {
+	{
+		QMutexLocker locker(&mutex);
+		quitting = true;
+		condition.wakeAll();
+	}
+
+	for (int i = 0; i < threads.size(); i++) {
+		threads.at(i)->wait();
+		delete threads.at(i);
+	}
+
+	delete[] queues;
+
+	debug(QString("Encoder pool stopped, %1 runs, %2 of which were stolen").arg((int)runs).arg((int)steals));
+}
+
+void EncoderPool::submit(Encoder *encoder) {
+	// encoders that get rescheduled by a pool thread go back to that
+	// thread's queue, new work from outside is distributed round robin
+
+	int index = -1;
+	QThread *current = QThread::currentThread();
+	for (int i = 0; i < threads.size(); i++)
+		if (threads.at(i) == current)
+			index = i;
+
+	if (index < 0) {
+		QMutexLocker locker(&mutex);
+		index = next;
+		next = (next + 1) % size;
+	}
+
+	{
+		QMutexLocker locker(&queues[index].mutex);
+		queues[index].encoders.append(encoder);
+	}
+
+	pending.ref();
+
+	QMutexLocker locker(&mutex);
+	condition.wakeOne();
+}
+
+Encoder *EncoderPool::takeFrom(int index, bool steal) {
+	// the owner takes from the front, thieves from the back, so they get
+	// in each other's way as little as possible
+
+	QMutexLocker locker(&queues[index].mutex);
+
+	if (queues[index].encoders.isEmpty())
+		return NULL;
+
+	pending.deref();
+	return steal ? queues[index].encoders.takeLast() : queues[index].encoders.takeFirst();
+}
+
+Encoder *EncoderPool::take(int index, Encoder *done) {
+	// the thread is out of done->process(), so it may be deleted now
+	if (done) {
+		QMutexLocker locker(&mutex);
+		busy.removeOne(done);
+		releaseCondition.wakeAll();
+	}
+
+	for (;;) {
+		Encoder *encoder = takeFrom(index, false);
+
+		for (int i = 1; !encoder && i < size; i++) {
+			encoder = takeFrom((index + i) % size, true);
+			if (encoder)
+				steals.ref();
+		}
+
+		if (encoder) {
+			runs.ref();
+			QMutexLocker locker(&mutex);
+			busy.append(encoder);
+			return encoder;
+		}
+
+		QMutexLocker locker(&mutex);
+		if (quitting)
+			return NULL;
+		if (pending == 0)
+			condition.wait(&mutex);
+	}
+}
+
+void EncoderPool::release(Encoder *encoder) {
+	QMutexLocker locker(&mutex);
+
+	while (busy.contains(encoder))
+		releaseCondition.wait(&mutex);
+}
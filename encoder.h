@@ -0,0 +1,216 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+#ifndef ENCODER_H
+#define ENCODER_H
+
+#include <QObject>
+#include <QThread>
+#include <QByteArray>
+#include <QAtomicInt>
+#include <QSemaphore>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QList>
+#include <QStringList>
+#include <QtGlobal>
+
+#include "common.h"
+
+class AudioFileWriter;
+
+// a block of PCM data on its way from the capture side to the writer.  the
+// storage of the blocks is reused, so that steady state operation does not
+// allocate memory
+
+struct PcmBlock {
+	PcmBlock() : samples(0), flush(false), end(false) { }
+
+	void resize(long, bool);
+	qint16 *leftData() { return reinterpret_cast<qint16 *>(left.data()); }
+	qint16 *rightData() { return reinterpret_cast<qint16 *>(right.data()); }
+
+	QByteArray left;
+	QByteArray right;
+	long samples;
+	bool flush;
+	bool end;
+};
+
+// lock-free single-producer/single-consumer queue of PCM blocks.  one slot
+// is always kept empty to tell a full queue from an empty one.  the indices
+// are published with release semantics and read with acquire semantics, so
+// that the block contents are visible to the other side
+
+class PcmQueue {
+public:
+	PcmQueue(int);
+	~PcmQueue();
+
+	// producer side: returns the next free block, or NULL if the queue is
+	// full.  the block must be filled and then published with push()
+	PcmBlock *back();
+	void push();
+
+	// consumer side: returns the oldest block, or NULL if the queue is
+	// empty.  the block must be released with pop() once it is processed
+	PcmBlock *front();
+	void pop();
+
+	int depth();
+	int capacity() const { return size - 1; }
+
+private:
+	PcmBlock *blocks;
+	int size;
+	QAtomicInt head;
+	QAtomicInt tail;
+
+	DISABLE_COPY_AND_ASSIGNMENT(PcmQueue);
+};
+
+// encodes the blocks of one recording.  the encoding itself happens on the
+// threads of the EncoderPool, so that slow encoders don't hold up the GUI
+// thread, which also reads the sockets.  an encoder is only ever processed
+// by one pool thread at a time, so blocks are written in order.  the writer
+// is closed there too, since that can take a while with the tail of the
+// encoding and a final sync
+
+class Encoder : public QObject {
+	Q_OBJECT
+public:
+	Encoder(AudioFileWriter *, int);
+	~Encoder();
+
+	// producer side, these must all be called from the same thread.
+	// getBlock() returns NULL if the queue is full, unless waiting was
+	// requested.  the returned block is queued with putBlock().  finish()
+	// queues the end of the recording and returns right away.  finished()
+	// is emitted once all blocks have been written and the writer has been
+	// closed.  deleting the encoder before that waits for it
+	PcmBlock *getBlock(bool = false);
+	void putBlock(bool);
+	void finish();
+	int queueDepth() { return queue.depth(); }
+	int queueCapacity() const { return queue.capacity(); }
+
+signals:
+	void failed();
+	void finished();
+	// some of several outputs failed and were dropped, the others carry
+	// on.  the files are closed and should be removed
+	void outputFailed(const QStringList &);
+
+private:
+	friend class EncoderPoolThread;
+	void process();
+
+private:
+	AudioFileWriter *writer;
+	int id;
+	PcmQueue queue;
+	PcmBlock *current;
+
+	// set while the encoder is queued in or processed by the pool
+	QAtomicInt scheduled;
+
+	// set by the producer when it is about to sleep because the queue is
+	// full, so the consumer knows it has to wake it up
+	QAtomicInt producerSleeping;
+	QSemaphore producerWakeup;
+
+	// set by finish()
+	bool hasEnded;
+
+	QMutex finishMutex;
+	QWaitCondition finishCondition;
+	bool isFinished;
+
+	bool hasFailed;
+
+	// statistics
+	qint64 blocks;
+	qint64 samples;
+	int maxDepth;
+	int busyTime;
+	int cpuTime;
+	bool warnedFull;
+
+	DISABLE_COPY_AND_ASSIGNMENT(Encoder);
+};
+
+// a process wide pool of encoder threads, one per CPU core.  each thread has
+// its own queue of encoders that have pending blocks.  idle threads steal
+// work from the queues of the others, so that many concurrent recordings
+// keep all cores busy
+
+class EncoderPool {
+public:
+	static EncoderPool *instance();
+	static void destroy();
+
+	void submit(Encoder *);
+
+private:
+	EncoderPool();
+	~EncoderPool();
+
+	friend class EncoderPoolThread;
+	friend class Encoder;
+	Encoder *take(int, Encoder *);
+	Encoder *takeFrom(int, bool);
+	void release(Encoder *);
+
+private:
+	struct WorkQueue {
+		QMutex mutex;
+		QList<Encoder *> encoders;
+	};
+
+	static EncoderPool *pool;
+
+	QList<QThread *> threads;
+	WorkQueue *queues;
+	int size;
+	int next;
+
+	// number of encoders in all queues together
+	QAtomicInt pending;
+
+	QMutex mutex;
+	QWaitCondition condition;
+	bool quitting;
+
+	// the encoders being processed by a thread, guarded by mutex
+	QList<Encoder *> busy;
+	QWaitCondition releaseCondition;
+
+	// statistics
+	QAtomicInt runs;
+	QAtomicInt steals;
+
+	DISABLE_COPY_AND_ASSIGNMENT(EncoderPool);
+};
+
+#endif
+
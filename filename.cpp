@@ -0,0 +1,116 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+#include <QDateTime>
+#include <QString>
+#include <ctime>
+
+#include "filename.h"
+
+namespace {
+QString escape(const QString &s) {
+	QString out = s;
+	out.replace('%', "%%");
+	out.replace('/', '_');
+	return out;
+}
+
+// with a negative segment, the segment number is left as "&n" for
+// getSegmentFileName(), and literal & characters are kept as "&&"
+QString segmentString(int segment) {
+	if (segment < 0)
+		return "&n";
+	if (segment == 0)
+		return QString();
+	return QString("%1").arg(segment, 3, 10, QChar('0'));
+}
+}
+
+QString expandFileName(const QString &path, const QString &pattern, const QString &skypeName,
+	const QString &displayName, const QString &mySkypeName, const QString &myDisplayName,
+	const QDateTime &timestamp, int segment)
+{
+	QString fileName;
+	QString amp = segment < 0 ? "&&" : "&";
+	bool hasSegment = false;
+
+	for (int i = 0; i < pattern.size(); i++) {
+		if (pattern.at(i) == QChar('&') && i + 1 < pattern.size()) {
+			i++;
+			if (pattern.at(i) == QChar('s'))
+				fileName += escape(skypeName).replace('&', amp);
+			else if (pattern.at(i) == QChar('d'))
+				fileName += escape(displayName).replace('&', amp);
+			else if (pattern.at(i) == QChar('t'))
+				fileName += escape(mySkypeName).replace('&', amp);
+			else if (pattern.at(i) == QChar('e'))
+				fileName += escape(myDisplayName).replace('&', amp);
+			else if (pattern.at(i) == QChar('n')) {
+				fileName += segmentString(segment);
+				hasSegment = true;
+			} else if (pattern.at(i) == QChar('&'))
+				fileName += amp;
+			else {
+				fileName += amp;
+				fileName += pattern.at(i);
+			}
+		} else if (pattern.at(i) == QChar('&')) {
+			fileName += amp;
+		} else {
+			fileName += pattern.at(i);
+		}
+	}
+
+	// segments must have different names, even if the pattern forgot
+	if (segment != 0 && !hasSegment)
+		fileName += ", part " + segmentString(segment);
+
+	// TODO: uhm, does QT provide any time formatting the strftime() way?
+	char *buf = new char[fileName.size() + 1024];
+	time_t t = timestamp.toTime_t();
+	struct tm *tm = std::localtime(&t);
+	std::strftime(buf, fileName.size() + 1024, fileName.toUtf8().constData(), tm);
+	fileName = QString::fromLocal8Bit(buf);
+	delete[] buf;
+
+	return QString(path).replace('&', amp) + '/' + fileName;
+}
+
+QString getSegmentFileName(const QString &pattern, int segment) {
+	QString fileName;
+
+	for (int i = 0; i < pattern.size(); i++) {
+		if (pattern.at(i) == QChar('&') && i + 1 < pattern.size()) {
+			i++;
+			if (pattern.at(i) == QChar('n'))
+				fileName += segmentString(segment);
+			else
+				fileName += pattern.at(i);
+		} else {
+			fileName += pattern.at(i);
+		}
+	}
+
+	return fileName;
+}
+
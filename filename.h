@@ -0,0 +1,46 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+#ifndef FILENAME_H
+#define FILENAME_H
+
+#include <QString>
+
+class QDateTime;
+
+// builds the full file name of a recording, without extension, from the
+// output path and a pattern.  in the pattern, "&s" and "&d" are the Skype
+// name and display name of the other side, "&t" and "&e" our own, "&n" the
+// segment number and "&&" a literal &.  the result goes through strftime()
+//
+// with a negative segment, the segment number is left as "&n" and literal
+// & characters are kept as "&&", for getSegmentFileName()
+QString expandFileName(const QString &, const QString &, const QString &, const QString &,
+	const QString &, const QString &, const QDateTime &, int);
+
+// turns a name from expandFileName() with a negative segment into the name
+// of the given segment
+QString getSegmentFileName(const QString &, int);
+
+#endif
+
@@ -0,0 +1,334 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+#include <QString>
+#include <cstdlib>
+#include <cstring>
+
+#include "filesink.h"
+#include "iobackend.h"
+#include "common.h"
+
+namespace {
+	const long alignment = 4096;
+}
+
+FileSink::FileSink() :
+	fd(-1),
+	backend(NULL),
+	current(NULL),
+	maxInFlight(1),
+	blockSize(0),
+	used(0),
+	blockOffset(0),
+	submitted(0),
+	flushed(0),
+	dirty(false),
+	failed(false),
+	flushInterval(0),
+	syncInterval(0),
+	writes(0),
+	syncs(0),
+	syncTotal(0),
+	syncMax(0)
+{
+}
+
+FileSink::~FileSink() {
+	if (fd >= 0) {
+		debug("WARNING: FileSink::~FileSink(): sink has not been closed, closing it now");
+		close();
+	}
+
+	if (current)
+		freeRequests.append(current);
+
+	for (int i = 0; i < freeRequests.size(); i++) {
+		std::free(freeRequests.at(i)->buffer);
+		delete freeRequests.at(i);
+	}
+}
+
+bool FileSink::open(int f, long size, int interval, const QString &type, int depth) {
+	size = (size + alignment - 1) / alignment * alignment;
+	if (size < alignment)
+		size = alignment;
+
+	fd = f;
+	blockSize = size;
+	maxInFlight = depth > 0 ? depth : 1;
+	flushInterval = interval * 1000;
+	lastFlush.start();
+
+	current = getRequest();
+	if (!current) {
+		fd = -1;
+		return false;
+	}
+
+	backend = IoBackend::create(type, maxInFlight);
+	debug(QString("FileSink: %1 KiB blocks, %2 writes in flight, %3 backend")
+		.arg(blockSize / 1024).arg(maxInFlight).arg(backend->name()));
+
+	return true;
+}
+
+bool FileSink::close() {
+	if (fd < 0)
+		return true;
+
+	bool ret = flush();
+
+	delete backend;
+	backend = NULL;
+	fd = -1;
+
+	return ret;
+}
+
+IoRequest *FileSink::getRequest() {
+	if (!freeRequests.isEmpty())
+		return freeRequests.takeLast();
+
+	void *p;
+	if (posix_memalign(&p, alignment, blockSize) != 0)
+		return NULL;
+
+	IoRequest *request = new IoRequest;
+	request->buffer = static_cast<char *>(p);
+	return request;
+}
+
+void FileSink::submit(IoRequest *request, long bytes, qint64 offset) {
+	// a write that overlaps with an earlier one must not overtake it
+
+	request->type = IoRequest::Write;
+	request->fd = fd;
+	request->bytes = bytes;
+	request->offset = offset;
+	request->ordered = offset < submitted;
+	request->done = 0;
+	request->error = 0;
+	request->started = ioTime();
+
+	if (offset + bytes > submitted)
+		submitted = offset + bytes;
+
+	inFlight.append(request);
+	backend->submit(request);
+	writes++;
+}
+
+bool FileSink::submitPartial() {
+	// the partial block stays where it is, the kernel gets a copy
+
+	if (!reap(maxInFlight - 1))
+		return false;
+
+	IoRequest *copy = getRequest();
+	if (!copy)
+		return false;
+
+	std::memcpy(copy->buffer, current->buffer, used);
+	submit(copy, used, blockOffset);
+	dirty = false;
+	return true;
+}
+
+bool FileSink::reap(int max) {
+	// collects completed writes, waiting until at most max are left in
+	// flight
+
+	QList<IoRequest *> done;
+	backend->reap(done, max);
+
+	for (int i = 0; i < done.size(); i++) {
+		IoRequest *request = done.at(i);
+
+		if (request->error && !failed) {
+			debug(QString("FileSink: write error: %1").arg(std::strerror(request->error)));
+			failed = true;
+		}
+
+		if (request->type == IoRequest::DataSync) {
+			// not the time of reaping, which may be much later
+			qint64 t = request->finished - request->started;
+			syncs++;
+			syncTotal += t;
+			if (t > syncMax)
+				syncMax = t;
+		}
+
+		inFlight.removeAll(request);
+		freeRequests.append(request);
+	}
+
+	// everything before the oldest write still in flight is in the file
+	flushed = submitted;
+	for (int i = 0; i < inFlight.size(); i++)
+		if (inFlight.at(i)->offset < flushed)
+			flushed = inFlight.at(i)->offset;
+
+	return !failed;
+}
+
+bool FileSink::write(const char *data, qint64 bytes) {
+	if (failed)
+		return false;
+
+	while (bytes > 0) {
+		long n = blockSize - used;
+		if (n > bytes)
+			n = bytes;
+
+		std::memcpy(current->buffer + used, data, n);
+		used += n;
+		data += n;
+		bytes -= n;
+		dirty = true;
+
+		if (used == blockSize) {
+			// a free request is needed for the next block, which
+			// is where we have to wait if the disk is too slow
+			if (!reap(maxInFlight - 1))
+				return false;
+
+			IoRequest *next = getRequest();
+			if (!next)
+				return false;
+
+			submit(current, blockSize, blockOffset);
+			current = next;
+			blockOffset += blockSize;
+			used = 0;
+			dirty = false;
+		}
+	}
+
+	if (flushInterval && dirty && lastFlush.elapsed() >= flushInterval) {
+		lastFlush.restart();
+		if (!submitPartial())
+			return false;
+	}
+
+	if (syncInterval && lastSync.elapsed() >= syncInterval) {
+		// the sync should cover everything written so far
+		if (dirty && !submitPartial())
+			return false;
+		if (!submitSync())
+			return false;
+	}
+
+	return reap(maxInFlight);
+}
+
+bool FileSink::writeAt(qint64 pos, const char *data, qint64 bytes) {
+	// the part that has already left the buffer is written separately,
+	// the rest is patched in the buffer and written with the next block
+
+	if (failed)
+		return false;
+
+	while (pos < blockOffset && bytes > 0) {
+		qint64 n = blockOffset - pos;
+		if (n > bytes)
+			n = bytes;
+		if (n > blockSize)
+			n = blockSize;
+
+		if (!reap(maxInFlight - 1))
+			return false;
+
+		IoRequest *request = getRequest();
+		if (!request)
+			return false;
+
+		std::memcpy(request->buffer, data, n);
+		submit(request, n, pos);
+
+		pos += n;
+		data += n;
+		bytes -= n;
+	}
+
+	if (bytes > 0) {
+		if (pos + bytes > blockOffset + used)
+			return false;
+		std::memcpy(current->buffer + (pos - blockOffset), data, bytes);
+		dirty = true;
+	}
+
+	return true;
+}
+
+bool FileSink::flush() {
+	lastFlush.restart();
+
+	if (failed)
+		return false;
+
+	if (dirty && !submitPartial())
+		return false;
+
+	return reap(0);
+}
+
+bool FileSink::sync() {
+	if (!flush() || !submitSync())
+		return false;
+
+	return reap(0);
+}
+
+void FileSink::setSyncInterval(int seconds) {
+	syncInterval = seconds * 1000;
+	lastSync.start();
+}
+
+bool FileSink::submitSync() {
+	// the sync is ordered behind all writes submitted before it, and is
+	// not waited for here
+
+	lastSync.restart();
+
+	if (!reap(maxInFlight - 1))
+		return false;
+
+	IoRequest *request = getRequest();
+	if (!request)
+		return false;
+
+	request->type = IoRequest::DataSync;
+	request->fd = fd;
+	request->bytes = 0;
+	request->offset = submitted;
+	request->ordered = true;
+	request->done = 0;
+	request->error = 0;
+	request->started = ioTime();
+
+	inFlight.append(request);
+	backend->submit(request);
+	return true;
+}
+
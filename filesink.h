@@ -0,0 +1,117 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+#ifndef FILESINK_H
+#define FILESINK_H
+
+#include <QTime>
+#include <QList>
+#include <QString>
+#include <QtGlobal>
+
+#include "common.h"
+
+class IoBackend;
+struct IoRequest;
+
+// FileSink - collects the output of a writer into large blocks before handing
+// it to the kernel.  blocks are aligned both in memory and in the file: full
+// blocks are written as they fill up, and a partially filled block is only
+// written on flush(), or when the flush interval has passed.  in that case,
+// the block is kept and later written again, from its beginning, once more
+// data has been added.  this keeps every write at a block boundary.
+//
+// the writes themselves go through an IoBackend, so they can be asynchronous.
+// only a limited number of them are in flight at any time; beyond that,
+// writing waits for the oldest ones to complete.  errors of asynchronous
+// writes are reported by the next call.
+
+class FileSink {
+public:
+	FileSink();
+	~FileSink();
+
+	// the file descriptor is not owned.  the block size is rounded up to
+	// a multiple of 4096 bytes.  a flush interval of 0 disables timed
+	// flushes.  the last two arguments are the IoBackend type and the
+	// maximum number of writes in flight
+	bool open(int, long, int, const QString &, int);
+	bool close();
+
+	bool write(const char *, qint64);
+	// overwrite data at the given position, which must have been written
+	// before.  used for headers that are updated later on
+	bool writeAt(qint64, const char *, qint64);
+	// writes everything and waits until it is done
+	bool flush();
+	// the same, followed by an fdatasync().  returns once it is on disk
+	bool sync();
+	// with a non-zero interval in seconds, an fdatasync() is queued
+	// behind the writes that often, without waiting for it
+	void setSyncInterval(int);
+
+	// number of bytes written to the sink, and how many of them have
+	// completely made it to the file
+	qint64 size() const { return blockOffset + used; }
+	qint64 flushedSize() const { return flushed; }
+	long writeCount() const { return writes; }
+	// completed syncs and their latency in microseconds
+	long syncCount() const { return syncs; }
+	qint64 syncTotalTime() const { return syncTotal; }
+	qint64 syncMaxTime() const { return syncMax; }
+
+private:
+	IoRequest *getRequest();
+	void submit(IoRequest *, long, qint64);
+	bool submitPartial();
+	bool submitSync();
+	bool reap(int);
+
+private:
+	int fd;
+	IoBackend *backend;
+	IoRequest *current;
+	QList<IoRequest *> freeRequests;
+	QList<IoRequest *> inFlight;
+	int maxInFlight;
+	long blockSize;
+	long used;
+	qint64 blockOffset;
+	qint64 submitted;
+	qint64 flushed;
+	bool dirty;
+	bool failed;
+	int flushInterval;
+	QTime lastFlush;
+	int syncInterval;
+	QTime lastSync;
+	long writes;
+	long syncs;
+	qint64 syncTotal;
+	qint64 syncMax;
+
+	DISABLE_COPY_AND_ASSIGNMENT(FileSink);
+};
+
+#endif
+
@@ -0,0 +1,226 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+// Note: FLAC frames are independent of each other, which lets libFLAC
+// encode them in parallel.  from libFLAC 1.5 on, it does that with its own
+// pool of threads when asked to, and hands the frames to the write callback
+// in order and one at a time.  with older versions, frames are encoded on
+// the writer's thread
+
+#include <QByteArray>
+#include <QString>
+#include <QThread>
+#include <QVector>
+#include <FLAC/stream_encoder.h>
+#include <FLAC/metadata.h>
+
+#include "flacwriter.h"
+#include "common.h"
+#include "preferences.h"
+
+struct FlacWriterPrivateData {
+	FLAC__StreamEncoder *encoder;
+	FLAC__StreamMetadata *tags;
+	FileSink *sink;
+	// where the next write callback goes.  libFLAC seeks back to the
+	// start when finishing, to fill in the STREAMINFO block
+	qint64 position;
+	QVector<FLAC__int32> left;
+	QVector<FLAC__int32> right;
+};
+
+namespace {
+FLAC__StreamEncoderWriteStatus writeCallback(const FLAC__StreamEncoder *, const FLAC__byte buffer[],
+	size_t bytes, unsigned, unsigned, void *data)
+{
+	FlacWriterPrivateData *pd = static_cast<FlacWriterPrivateData *>(data);
+	const char *p = reinterpret_cast<const char *>(buffer);
+	bool ok;
+
+	if (pd->position < pd->sink->size())
+		ok = pd->sink->writeAt(pd->position, p, bytes);
+	else
+		ok = pd->sink->write(p, bytes);
+
+	if (!ok)
+		return FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR;
+
+	pd->position += bytes;
+	return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+}
+
+FLAC__StreamEncoderSeekStatus seekCallback(const FLAC__StreamEncoder *, FLAC__uint64 offset, void *data) {
+	FlacWriterPrivateData *pd = static_cast<FlacWriterPrivateData *>(data);
+
+	if ((qint64)offset > pd->sink->size())
+		return FLAC__STREAM_ENCODER_SEEK_STATUS_ERROR;
+
+	pd->position = offset;
+	return FLAC__STREAM_ENCODER_SEEK_STATUS_OK;
+}
+
+FLAC__StreamEncoderTellStatus tellCallback(const FLAC__StreamEncoder *, FLAC__uint64 *offset, void *data) {
+	FlacWriterPrivateData *pd = static_cast<FlacWriterPrivateData *>(data);
+	*offset = pd->position;
+	return FLAC__STREAM_ENCODER_TELL_STATUS_OK;
+}
+
+bool addTag(FLAC__StreamMetadata *tags, const char *name, const QString &value) {
+	FLAC__StreamMetadata_VorbisComment_Entry entry;
+
+	if (!FLAC__metadata_object_vorbiscomment_entry_from_name_value_pair(&entry, name, value.toUtf8().constData()))
+		return false;
+
+	// the entry is taken over by the metadata object
+	return FLAC__metadata_object_vorbiscomment_append_comment(tags, entry, false);
+}
+
+void convert(QVector<FLAC__int32> &out, const qint16 *in, long samples) {
+	out.resize(samples);
+	FLAC__int32 *d = out.data();
+	for (long i = 0; i < samples; i++)
+		d[i] = in[i];
+}
+}
+
+FlacWriter::FlacWriter() :
+	pd(NULL),
+	hasFlushed(false)
+{
+}
+
+FlacWriter::~FlacWriter() {
+	if (file.isOpen()) {
+		debug("WARNING: FlacWriter::~FlacWriter(): File has not been closed, closing it now");
+		close();
+	}
+
+	if (pd) {
+		if (pd->encoder)
+			FLAC__stream_encoder_delete(pd->encoder);
+		if (pd->tags)
+			FLAC__metadata_object_delete(pd->tags);
+		delete pd;
+	}
+}
+
+bool FlacWriter::open(const QString &fn, long sr, bool s) {
+	bool b = AudioFileWriter::open(fn + ".flac", sr, s);
+
+	if (!b)
+		return false;
+
+	int level = prefs->get(Pref::OutputFormatFlacLevel).toInt();
+
+	pd = new FlacWriterPrivateData;
+	pd->encoder = FLAC__stream_encoder_new();
+	pd->tags = NULL;
+	pd->sink = &sink;
+	pd->position = 0;
+
+	if (!pd->encoder)
+		return false;
+
+	FLAC__stream_encoder_set_channels(pd->encoder, stereo ? 2 : 1);
+	FLAC__stream_encoder_set_bits_per_sample(pd->encoder, 16);
+	FLAC__stream_encoder_set_sample_rate(pd->encoder, sampleRate);
+	FLAC__stream_encoder_set_compression_level(pd->encoder, level);
+
+#if FLAC_API_VERSION_CURRENT >= 14
+	int threads = QThread::idealThreadCount();
+	if (threads > 1) {
+		if (FLAC__stream_encoder_set_num_threads(pd->encoder, threads) == FLAC__STREAM_ENCODER_SET_NUM_THREADS_OK)
+			debug(QString("FlacWriter: encoding with %1 threads").arg(threads));
+		else
+			debug("FlacWriter: libFLAC does not support threads, encoding with one thread");
+	}
+#endif
+
+	pd->tags = FLAC__metadata_object_new(FLAC__METADATA_TYPE_VORBIS_COMMENT);
+	if (!pd->tags)
+		return false;
+
+	if (!addTag(pd->tags, "COMMENT", tagComment) ||
+			!addTag(pd->tags, "DATE", tagTime.toString("yyyy-MM-dd hh:mm")) ||
+			!addTag(pd->tags, "GENRE", "Speech (Skype Call)"))
+		return false;
+
+	FLAC__stream_encoder_set_metadata(pd->encoder, &pd->tags, 1);
+
+	if (FLAC__stream_encoder_init_stream(pd->encoder, writeCallback, seekCallback, tellCallback, NULL, pd) !=
+			FLAC__STREAM_ENCODER_INIT_STATUS_OK)
+		return false;
+
+	return true;
+}
+
+void FlacWriter::close() {
+	if (!file.isOpen()) {
+		debug("WARNING: FlacWriter::close() called, but file not open");
+		return;
+	}
+
+	if (!hasFlushed) {
+		debug("WARNING: FlacWriter::close() called but no flush happened, flushing now");
+		write(NULL, NULL, 0, true);
+	}
+
+	AudioFileWriter::close();
+}
+
+bool FlacWriter::write(const qint16 *left, const qint16 *right, long samples, bool flush) {
+	// after an error, libFLAC must not be called anymore
+	if (!pd || !pd->encoder || FLAC__stream_encoder_get_state(pd->encoder) != FLAC__STREAM_ENCODER_OK)
+		return false;
+
+	if (samples > 0) {
+		const FLAC__int32 *buffers[2];
+
+		convert(pd->left, left, samples);
+		buffers[0] = pd->left.constData();
+
+		if (stereo) {
+			convert(pd->right, right, samples);
+			buffers[1] = pd->right.constData();
+		}
+
+		if (!FLAC__stream_encoder_process(pd->encoder, buffers, samples)) {
+			debug(QString("FlacWriter: encoder error: %1")
+				.arg(FLAC__stream_encoder_get_resolved_state_string(pd->encoder)));
+			return false;
+		}
+	}
+
+	samplesWritten += samples;
+
+	if (!flush)
+		return true;
+
+	// this writes the last frame and fills in the STREAMINFO block
+	hasFlushed = true;
+	if (!FLAC__stream_encoder_finish(pd->encoder))
+		return false;
+
+	return sink.flush();
+}
+
@@ -0,0 +1,132 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QString>
+
+#include "id3tag.h"
+#include "common.h"
+
+namespace {
+void appendUInt32BE(QByteArray &array, quint32 i) {
+	array.append((char)(i >> 24));
+	array.append((char)(i >> 16));
+	array.append((char)(i >> 8));
+	array.append((char)i);
+}
+
+// ISO-8859-1 if possible, otherwise UTF-16 with BOM.  the terminator is
+// only added if asked for
+QByteArray encodeText(const QString &str, bool latin1, bool terminate) {
+	QByteArray out;
+	if (latin1) {
+		out = str.toLatin1();
+		if (terminate)
+			out.append('\0');
+	} else {
+		out.append('\xff');
+		out.append('\xfe');
+		for (int i = 0; i < str.size(); i++) {
+			ushort c = str.at(i).unicode();
+			out.append((char)c);
+			out.append((char)(c >> 8));
+		}
+		if (terminate)
+			out.append(QByteArray(2, 0));
+	}
+	return out;
+}
+
+bool isLatin1(const QString &str) {
+	for (int i = 0; i < str.size(); i++)
+		if (str.at(i).unicode() > 0xff)
+			return false;
+	return true;
+}
+
+QByteArray frame(const char *id, const QByteArray &body) {
+	QByteArray out(id);
+	appendUInt32BE(out, body.size());
+	out.append(QByteArray(2, 0));     // flags
+	out.append(body);
+	return out;
+}
+
+QByteArray textFrame(const char *id, const QString &text) {
+	bool latin1 = isLatin1(text);
+	QByteArray body(1, (char)(latin1 ? 0 : 1));
+	body.append(encodeText(text, latin1, false));
+	return frame(id, body);
+}
+
+QByteArray commentFrame(const QString &text) {
+	bool latin1 = isLatin1(text);
+	QByteArray body(1, (char)(latin1 ? 0 : 1));
+	body.append("eng");
+	body.append(encodeText(QString(), latin1, true));
+	body.append(encodeText(text, latin1, false));
+	return frame("COMM", body);
+}
+}
+
+QByteArray buildId3Tag(const QDateTime &tagTime, const QString &tagComment) {
+	QString str = tagTime.toString("yyyyddMMhhmm");
+
+	QByteArray frames;
+	frames.append(textFrame("TCON", "(101)Skype Call"));
+	frames.append(textFrame("TYER", str.mid(0, 4)));
+	frames.append(textFrame("TDAT", str.mid(4, 4)));
+	frames.append(textFrame("TIME", str.mid(8, 4)));
+
+	// NOTE: we don't set TIT2 (title) as the file name is already meant
+	// to be a good enough description of the content
+
+	QString comment = tagComment;
+	QByteArray commentData = commentFrame(comment);
+	while (10 + frames.size() + commentData.size() > id3TagSize) {
+		comment.chop(16);
+		commentData = commentFrame(comment);
+	}
+	if (comment.size() < tagComment.size())
+		debug("WARNING: Mp3Writer: comment tag too long, truncating it");
+	frames.append(commentData);
+
+	QByteArray tag("ID3");
+	tag.append((char)3);              // version 2.3.0
+	tag.append((char)0);
+	tag.append((char)0);              // flags
+	appendSyncsafe(tag, id3TagSize - 10); // size excluding this header
+	tag.append(frames);
+	tag.append(QByteArray(id3TagSize - tag.size(), 0)); // padding
+
+	return tag;
+}
+
+void appendSyncsafe(QByteArray &array, quint32 i) {
+	array.append((char)((i >> 21) & 0x7f));
+	array.append((char)((i >> 14) & 0x7f));
+	array.append((char)((i >> 7) & 0x7f));
+	array.append((char)(i & 0x7f));
+}
+
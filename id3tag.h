@@ -0,0 +1,47 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+#ifndef ID3TAG_H
+#define ID3TAG_H
+
+#include <QByteArray>
+#include <QtGlobal>
+
+class QDateTime;
+class QString;
+
+// everything about the ID3v2.3 tag at the start of the MP3 files is fixed in
+// size, so that it can be rewritten in place at the end, no matter how long
+// the recording is.  this includes the 10 byte tag header
+const int id3TagSize = 4096;
+
+// builds the tag for a recording started at the given time, padded to
+// id3TagSize.  the comment is truncated if it doesn't fit
+QByteArray buildId3Tag(const QDateTime &, const QString &);
+
+// appends a 28 bit "syncsafe" integer, which has 7 bits in each byte, as
+// used for the size in the tag header
+void appendSyncsafe(QByteArray &, quint32);
+
+#endif
+
@@ -0,0 +1,411 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+#include <QThread>
+#include <cerrno>
+#include <ctime>
+#include <unistd.h>
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+#include "iobackend.h"
+#include "common.h"
+
+namespace {
+
+// performs the remaining part of a request with blocking calls
+void performRequest(IoRequest *request) {
+	if (request->type == IoRequest::DataSync) {
+		int ret;
+		do {
+			ret = fdatasync(request->fd);
+		} while (ret != 0 && errno == EINTR);
+		if (ret != 0)
+			request->error = errno;
+		return;
+	}
+
+	while (request->done < request->bytes) {
+		ssize_t ret = pwrite(request->fd, request->buffer + request->done,
+			request->bytes - request->done, request->offset + request->done);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0) {
+			request->error = ret < 0 ? errno : EIO;
+			return;
+		}
+		request->done += ret;
+	}
+}
+
+// SyncIoBackend - writes right away, like a plain write() would
+
+class SyncIoBackend : public IoBackend {
+public:
+	SyncIoBackend() { }
+
+	virtual const char *name() const { return "sync"; }
+
+	virtual void submit(IoRequest *request) {
+		performRequest(request);
+		request->finished = ioTime();
+		completed.append(request);
+	}
+
+	virtual void reap(QList<IoRequest *> &list, int) {
+		list += completed;
+		completed.clear();
+	}
+
+private:
+	QList<IoRequest *> completed;
+
+	DISABLE_COPY_AND_ASSIGNMENT(SyncIoBackend);
+};
+
+#ifdef HAVE_LIBURING
+
+// UringIoBackend - each backend has its own ring, sized for the number of
+// requests in flight.  completions are only looked at in reap(), without
+// blocking unless there are too many requests in flight.  short writes are
+// resubmitted for the rest.  since a resubmission goes to the ring after
+// the requests submitted in the meantime, IOSQE_IO_DRAIN can't keep ordered
+// requests after it.  instead, an ordered request is held back until
+// everything before it has completely finished, and so is everything after
+// it
+
+class UringIoBackend : public IoBackend {
+public:
+	UringIoBackend() : initialized(false), inFlight(0), inRing(0) { }
+
+	virtual ~UringIoBackend() {
+		if (!initialized)
+			return;
+
+		// the kernel might still access the buffers otherwise
+		QList<IoRequest *> list;
+		reap(list, 0);
+		io_uring_queue_exit(&ring);
+	}
+
+	bool init(int depth) {
+		initialized = io_uring_queue_init(depth, &ring, 0) == 0;
+		return initialized;
+	}
+
+	virtual const char *name() const { return "io_uring"; }
+
+	virtual void submit(IoRequest *request) {
+		inFlight++;
+		if (!held.isEmpty() || (request->ordered && inRing))
+			held.append(request);
+		else
+			queue(request);
+	}
+
+	virtual void reap(QList<IoRequest *> &list, int maxInFlight) {
+		for (;;) {
+			submitHeld();
+			if (!inRing)
+				break;
+
+			struct io_uring_cqe *cqe;
+			int ret;
+
+			if (inFlight > maxInFlight)
+				ret = io_uring_wait_cqe(&ring, &cqe);
+			else
+				ret = io_uring_peek_cqe(&ring, &cqe);
+
+			if (ret == -EINTR)
+				continue;
+			if (ret < 0)
+				break;
+
+			IoRequest *request = static_cast<IoRequest *>(io_uring_cqe_get_data(cqe));
+			int res = cqe->res;
+			io_uring_cqe_seen(&ring, cqe);
+			inRing--;
+
+			if (res == -EINTR || res == -EAGAIN) {
+				queue(request);
+				continue;
+			}
+
+			if (res < 0) {
+				request->error = -res;
+			} else if (request->type == IoRequest::Write) {
+				if (res == 0) {
+					request->error = EIO;
+				} else {
+					request->done += res;
+					if (request->done < request->bytes) {
+						queue(request);
+						continue;
+					}
+				}
+			}
+
+			request->finished = ioTime();
+			inFlight--;
+			list.append(request);
+		}
+
+		list += completed;
+		completed.clear();
+	}
+
+private:
+	// submits the held requests up to the next ordered one that still has
+	// to wait
+	void submitHeld() {
+		while (!held.isEmpty() && !(held.first()->ordered && inRing))
+			queue(held.takeFirst());
+	}
+
+	void queue(IoRequest *request) {
+		struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+		if (!sqe) {
+			// can't happen, since there are never more requests
+			// in flight than the ring has entries
+			performRequest(request);
+			request->finished = ioTime();
+			inFlight--;
+			completed.append(request);
+			return;
+		}
+
+		if (request->type == IoRequest::DataSync) {
+			io_uring_prep_fsync(sqe, request->fd, IORING_FSYNC_DATASYNC);
+		} else {
+			request->iov.iov_base = request->buffer + request->done;
+			request->iov.iov_len = request->bytes - request->done;
+			io_uring_prep_writev(sqe, request->fd, &request->iov, 1, request->offset + request->done);
+		}
+		io_uring_sqe_set_data(sqe, request);
+		io_uring_submit(&ring);
+		inRing++;
+	}
+
+private:
+	struct io_uring ring;
+	bool initialized;
+	// requests submitted to us and not reaped yet
+	int inFlight;
+	// requests in the ring, including resubmissions
+	int inRing;
+	QList<IoRequest *> held;
+	QList<IoRequest *> completed;
+
+	DISABLE_COPY_AND_ASSIGNMENT(UringIoBackend);
+};
+
+#endif
+
+}
+
+qint64 ioTime() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (qint64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// IoBackend
+
+IoBackend *IoBackend::create(const QString &type, int depth) {
+	if (type == "sync")
+		return new SyncIoBackend;
+
+#ifdef HAVE_LIBURING
+	if (type == "auto" || type == "uring") {
+		UringIoBackend *backend = new UringIoBackend;
+		if (backend->init(depth))
+			return backend;
+		delete backend;
+		debug("io_uring is not available, using I/O threads instead");
+	}
+#else
+	(void)depth;
+	if (type == "uring")
+		debug("io_uring support is not compiled in, using I/O threads instead");
+#endif
+
+	return new ThreadIoBackend;
+}
+
+// ThreadIoBackend
+
+ThreadIoBackend::ThreadIoBackend() :
+	inFlight(0),
+	scheduled(false)
+{
+}
+
+ThreadIoBackend::~ThreadIoBackend() {
+	QList<IoRequest *> list;
+	reap(list, 0);
+
+	// the pool thread may still be on its way out of process(), and
+	// unlocking our mutex.  the pool knows when it is done with us
+	IoPool::instance()->release(this);
+}
+
+void ThreadIoBackend::submit(IoRequest *request) {
+	bool schedule;
+
+	{
+		QMutexLocker locker(&mutex);
+		pending.append(request);
+		inFlight++;
+		schedule = !scheduled;
+		scheduled = true;
+	}
+
+	if (schedule)
+		IoPool::instance()->submit(this);
+}
+
+void ThreadIoBackend::reap(QList<IoRequest *> &list, int maxInFlight) {
+	QMutexLocker locker(&mutex);
+
+	while (inFlight > maxInFlight)
+		condition.wait(&mutex);
+
+	list += completed;
+	completed.clear();
+}
+
+void ThreadIoBackend::process() {
+	QMutexLocker locker(&mutex);
+
+	while (!pending.isEmpty()) {
+		IoRequest *request = pending.takeFirst();
+
+		locker.unlock();
+		performRequest(request);
+		request->finished = ioTime();
+		locker.relock();
+
+		completed.append(request);
+		inFlight--;
+		condition.wakeAll();
+	}
+
+	scheduled = false;
+}
+
+// IoPoolThread
+
+class IoPoolThread : public QThread {
+public:
+	IoPoolThread(IoPool *p) : pool(p) { }
+
+protected:
+	virtual void run() {
+		ThreadIoBackend *backend = NULL;
+		while ((backend = pool->take(backend)))
+			backend->process();
+	}
+
+private:
+	IoPool *pool;
+};
+
+// IoPool
+
+namespace {
+	const int ioThreads = 2;
+}
+
+IoPool *IoPool::pool = NULL;
+
+IoPool *IoPool::instance() {
+	// the Recorder creates the pool on the GUI thread at start up, so
+	// that it exists before any writer is opened on an encoder thread
+	if (!pool)
+		pool = new IoPool;
+	return pool;
+}
+
+void IoPool::destroy() {
+	delete pool;
+	pool = NULL;
+}
+
+IoPool::IoPool() :
+	quitting(false)
+{
+	for (int i = 0; i < ioThreads; i++) {
+		QThread *thread = new IoPoolThread(this);
+		thread->start();
+		threads.append(thread);
+	}
+}
+
+IoPool::~IoPool() {
+	{
+		QMutexLocker locker(&mutex);
+		quitting = true;
+		condition.wakeAll();
+	}
+
+	for (int i = 0; i < threads.size(); i++) {
+		threads.at(i)->wait();
+		delete threads.at(i);
+	}
+}
+
+void IoPool::submit(ThreadIoBackend *backend) {
+	QMutexLocker locker(&mutex);
+	queue.append(backend);
+	condition.wakeOne();
+}
+
+ThreadIoBackend *IoPool::take(ThreadIoBackend *done) {
+	QMutexLocker locker(&mutex);
+
+	// the thread is out of done->process() and has released its mutex,
+	// so the backend may be deleted now
+	if (done) {
+		busy.removeOne(done);
+		condition.wakeAll();
+	}
+
+	while (queue.isEmpty() && !quitting)
+		condition.wait(&mutex);
+
+	if (queue.isEmpty())
+		return NULL;
+	ThreadIoBackend *backend = queue.takeFirst();
+	busy.append(backend);
+	return backend;
+}
+
+void IoPool::release(ThreadIoBackend *backend) {
+	QMutexLocker locker(&mutex);
+
+	while (busy.contains(backend))
+		condition.wait(&mutex);
+}
+
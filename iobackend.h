@@ -0,0 +1,148 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+#ifndef IOBACKEND_H
+#define IOBACKEND_H
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QList>
+#include <QString>
+#include <QtGlobal>
+#include <sys/uio.h>
+
+#include "common.h"
+
+class QThread;
+
+// a write of one buffer at a given file offset, or an fdatasync() of the
+// file.  the request and its buffer must not be touched while the request is
+// in flight
+
+struct IoRequest {
+	enum Type { Write, DataSync };
+
+	Type type;
+	int fd;
+	char *buffer;
+	long bytes;
+	qint64 offset;
+	// an ordered request only starts after all earlier ones have finished.
+	// this is needed when it overlaps with any of them.  syncs are always
+	// ordered
+	bool ordered;
+	long done;
+	int error;
+	struct iovec iov;
+	// submission time, set by the submitter, and the time the backend
+	// found the request to be finished, in microseconds of ioTime().  for
+	// the submitter's statistics
+	qint64 started;
+	qint64 finished;
+};
+
+// a monotonic clock in microseconds
+qint64 ioTime();
+
+// a way of performing IoRequests.  submit() and reap() must not be called
+// concurrently, but may be called from different threads
+
+class IoBackend {
+public:
+	// "auto" uses io_uring if possible, otherwise I/O threads.  "uring"
+	// also falls back to I/O threads.  "threads" and "sync" (write
+	// immediately in the calling thread) are always available.  the
+	// second argument is the most requests that will be in flight
+	static IoBackend *create(const QString &, int);
+	virtual ~IoBackend() { }
+
+	virtual const char *name() const = 0;
+	virtual void submit(IoRequest *) = 0;
+	// appends completed requests to the list, after waiting until no more
+	// than the given number of requests are in flight
+	virtual void reap(QList<IoRequest *> &, int) = 0;
+};
+
+// writes are done by the threads of the IoPool.  the requests of one backend
+// are processed in order by one thread at a time, so they never overlap
+
+class ThreadIoBackend : public IoBackend {
+public:
+	ThreadIoBackend();
+	virtual ~ThreadIoBackend();
+
+	virtual const char *name() const { return "threads"; }
+	virtual void submit(IoRequest *);
+	virtual void reap(QList<IoRequest *> &, int);
+
+private:
+	friend class IoPoolThread;
+	void process();
+
+private:
+	QMutex mutex;
+	QWaitCondition condition;
+	QList<IoRequest *> pending;
+	QList<IoRequest *> completed;
+	int inFlight;
+	// set while the backend is queued in or processed by the pool
+	bool scheduled;
+
+	DISABLE_COPY_AND_ASSIGNMENT(ThreadIoBackend);
+};
+
+// a small process wide pool of threads doing blocking writes for
+// ThreadIoBackend, so that a slow disk never blocks the encoders
+
+class IoPool {
+public:
+	static IoPool *instance();
+	static void destroy();
+
+	void submit(ThreadIoBackend *);
+
+private:
+	IoPool();
+	~IoPool();
+
+	friend class IoPoolThread;
+	friend class ThreadIoBackend;
+	ThreadIoBackend *take(ThreadIoBackend *);
+	void release(ThreadIoBackend *);
+
+private:
+	static IoPool *pool;
+
+	QList<QThread *> threads;
+	QList<ThreadIoBackend *> queue;
+	// the backends being processed by a thread
+	QList<ThreadIoBackend *> busy;
+	QMutex mutex;
+	QWaitCondition condition;
+	bool quitting;
+
+	DISABLE_COPY_AND_ASSIGNMENT(IoPool);
+};
+
+#endif
+
@@ -0,0 +1,254 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+#include <cstring>
+
+#include "mixer.h"
+#include "cpu.h"
+
+namespace {
+
+// panning factors in Q15.  only valid for 0 < pan < 100, so both fit into a
+// qint16, which the SIMD versions need
+
+void panFactors(int pan, qint32 &fl, qint32 &fr) {
+	fr = (pan * 32768 + 50) / 100;
+	fl = 32768 - fr;
+}
+
+// (l + r) / 2, rounded towards zero, without leaving 16 bits: the rounded
+// down average is the common bits plus half of the differing ones, and a
+// negative odd sum must be rounded up instead.  this lets compilers put twice
+// as many samples into a vector as with 32 bit intermediates
+
+inline qint16 mixMonoSample(qint16 l, qint16 r) {
+	qint16 x = l ^ r;
+	qint16 a = (qint16)((l & r) + (x >> 1));
+	return (qint16)(a + ((a >> 15) & x & 1));
+}
+
+inline qint16 mixPanSample(qint32 l, qint32 r, qint32 fl, qint32 fr) {
+	return (l * fl + r * fr + 16384) >> 15;
+}
+
+// portable versions
+
+// the mono mix is done in runs of 32 samples.  a loop with a fixed count and
+// no aliasing is one that compilers vectorize even at -O2
+
+void mixToMonoScalar(qint16 *__restrict__ output, const qint16 *__restrict__ local,
+	const qint16 *__restrict__ remote, long samples)
+{
+	long i = 0;
+
+	for (; i + 32 <= samples; i += 32)
+		for (int j = 0; j < 32; j++)
+			output[i + j] = mixMonoSample(local[i + j], remote[i + j]);
+
+	for (; i < samples; i++)
+		output[i] = mixMonoSample(local[i], remote[i]);
+}
+
+void mixToStereoScalar(qint16 *outputLeft, qint16 *outputRight, const qint16 *local, const qint16 *remote, long samples, qint32 fl, qint32 fr) {
+	for (long i = 0; i < samples; i++) {
+		outputLeft[i] = mixPanSample(local[i], remote[i], fl, fr);
+		outputRight[i] = mixPanSample(local[i], remote[i], fr, fl);
+	}
+}
+
+#ifdef HAVE_X86_SIMD
+
+// the vector versions interleave local and remote samples to pairs of 16 bit
+// values and use pmaddwd to get l * a + r * b as 32 bit values in one go.
+// for the mono mix, a and b are 1, and adding the sign bit before the
+// arithmetic shift makes the division round towards zero like the scalar
+// version does.  the tail is left to the scalar code
+
+__attribute__((target("sse2")))
+void mixToMonoSSE2(qint16 *output, const qint16 *local, const qint16 *remote, long samples) {
+	const __m128i ones = _mm_set1_epi16(1);
+	long i = 0;
+
+	for (; i + 8 <= samples; i += 8) {
+		__m128i l = _mm_loadu_si128((const __m128i *)(local + i));
+		__m128i r = _mm_loadu_si128((const __m128i *)(remote + i));
+		__m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(l, r), ones);
+		__m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(l, r), ones);
+		lo = _mm_srai_epi32(_mm_add_epi32(lo, _mm_srli_epi32(lo, 31)), 1);
+		hi = _mm_srai_epi32(_mm_add_epi32(hi, _mm_srli_epi32(hi, 31)), 1);
+		_mm_storeu_si128((__m128i *)(output + i), _mm_packs_epi32(lo, hi));
+	}
+
+	mixToMonoScalar(output + i, local + i, remote + i, samples - i);
+}
+
+__attribute__((target("sse2")))
+void mixToStereoSSE2(qint16 *outputLeft, qint16 *outputRight, const qint16 *local, const qint16 *remote, long samples, qint32 fl, qint32 fr) {
+	const __m128i factorsLeft = _mm_set1_epi32((fr << 16) | fl);
+	const __m128i factorsRight = _mm_set1_epi32((fl << 16) | fr);
+	const __m128i round = _mm_set1_epi32(16384);
+	long i = 0;
+
+	for (; i + 8 <= samples; i += 8) {
+		__m128i l = _mm_loadu_si128((const __m128i *)(local + i));
+		__m128i r = _mm_loadu_si128((const __m128i *)(remote + i));
+		__m128i lo = _mm_unpacklo_epi16(l, r);
+		__m128i hi = _mm_unpackhi_epi16(l, r);
+
+		__m128i leftLo = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(lo, factorsLeft), round), 15);
+		__m128i leftHi = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(hi, factorsLeft), round), 15);
+		_mm_storeu_si128((__m128i *)(outputLeft + i), _mm_packs_epi32(leftLo, leftHi));
+
+		__m128i rightLo = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(lo, factorsRight), round), 15);
+		__m128i rightHi = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(hi, factorsRight), round), 15);
+		_mm_storeu_si128((__m128i *)(outputRight + i), _mm_packs_epi32(rightLo, rightHi));
+	}
+
+	mixToStereoScalar(outputLeft + i, outputRight + i, local + i, remote + i, samples - i, fl, fr);
+}
+
+// the same with 256 bit vectors.  unpack and pack both work within 128 bit
+// lanes, so they cancel out and the samples stay in order
+
+__attribute__((target("avx2")))
+void mixToMonoAVX2(qint16 *output, const qint16 *local, const qint16 *remote, long samples) {
+	const __m256i ones = _mm256_set1_epi16(1);
+	long i = 0;
+
+	for (; i + 16 <= samples; i += 16) {
+		__m256i l = _mm256_loadu_si256((const __m256i *)(local + i));
+		__m256i r = _mm256_loadu_si256((const __m256i *)(remote + i));
+		__m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi16(l, r), ones);
+		__m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi16(l, r), ones);
+		lo = _mm256_srai_epi32(_mm256_add_epi32(lo, _mm256_srli_epi32(lo, 31)), 1);
+		hi = _mm256_srai_epi32(_mm256_add_epi32(hi, _mm256_srli_epi32(hi, 31)), 1);
+		_mm256_storeu_si256((__m256i *)(output + i), _mm256_packs_epi32(lo, hi));
+	}
+
+	mixToMonoScalar(output + i, local + i, remote + i, samples - i);
+}
+
+__attribute__((target("avx2")))
+void mixToStereoAVX2(qint16 *outputLeft, qint16 *outputRight, const qint16 *local, const qint16 *remote, long samples, qint32 fl, qint32 fr) {
+	const __m256i factorsLeft = _mm256_set1_epi32((fr << 16) | fl);
+	const __m256i factorsRight = _mm256_set1_epi32((fl << 16) | fr);
+	const __m256i round = _mm256_set1_epi32(16384);
+	long i = 0;
+
+	for (; i + 16 <= samples; i += 16) {
+		__m256i l = _mm256_loadu_si256((const __m256i *)(local + i));
+		__m256i r = _mm256_loadu_si256((const __m256i *)(remote + i));
+		__m256i lo = _mm256_unpacklo_epi16(l, r);
+		__m256i hi = _mm256_unpackhi_epi16(l, r);
+
+		__m256i leftLo = _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(lo, factorsLeft), round), 15);
+		__m256i leftHi = _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(hi, factorsLeft), round), 15);
+		_mm256_storeu_si256((__m256i *)(outputLeft + i), _mm256_packs_epi32(leftLo, leftHi));
+
+		__m256i rightLo = _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(lo, factorsRight), round), 15);
+		__m256i rightHi = _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(hi, factorsRight), round), 15);
+		_mm256_storeu_si256((__m256i *)(outputRight + i), _mm256_packs_epi32(rightLo, rightHi));
+	}
+
+	mixToStereoScalar(outputLeft + i, outputRight + i, local + i, remote + i, samples - i, fl, fr);
+}
+
+#endif
+
+// run time selection
+
+struct Kernels {
+	void (*mono)(qint16 *, const qint16 *, const qint16 *, long);
+	void (*stereo)(qint16 *, qint16 *, const qint16 *, const qint16 *, long, qint32, qint32);
+	const char *name;
+};
+
+const Kernels scalarKernels = { mixToMonoScalar, mixToStereoScalar, "scalar" };
+#ifdef HAVE_X86_SIMD
+const Kernels sse2Kernels = { mixToMonoSSE2, mixToStereoSSE2, "SSE2" };
+const Kernels avx2Kernels = { mixToMonoAVX2, mixToStereoAVX2, "AVX2" };
+#endif
+
+const Kernels *selectKernels() {
+#ifdef HAVE_X86_SIMD
+	if (cpuHasAVX2())
+		return &avx2Kernels;
+	if (cpuHasSSE2())
+		return &sse2Kernels;
+#endif
+	return &scalarKernels;
+}
+
+const Kernels *findKernels(const char *name) {
+	if (std::strcmp(name, scalarKernels.name) == 0)
+		return &scalarKernels;
+#ifdef HAVE_X86_SIMD
+	if (std::strcmp(name, sse2Kernels.name) == 0 && cpuHasSSE2())
+		return &sse2Kernels;
+	if (std::strcmp(name, avx2Kernels.name) == 0 && cpuHasAVX2())
+		return &avx2Kernels;
+#endif
+	return NULL;
+}
+
+// every thread would select the same, so a race here is harmless
+const Kernels *kernels = NULL;
+
+inline const Kernels *getKernels() {
+	if (!kernels)
+		kernels = selectKernels();
+	return kernels;
+}
+
+}
+
+void mixToMono(qint16 *output, const qint16 *local, const qint16 *remote, long samples) {
+	getKernels()->mono(output, local, remote, samples);
+}
+
+void mixToStereo(qint16 *outputLeft, qint16 *outputRight, const qint16 *local, const qint16 *remote, long samples, int pan) {
+	if (pan <= 0) {
+		std::memcpy(outputLeft, local, samples * 2);
+		std::memcpy(outputRight, remote, samples * 2);
+	} else if (pan >= 100) {
+		std::memcpy(outputLeft, remote, samples * 2);
+		std::memcpy(outputRight, local, samples * 2);
+	} else {
+		qint32 fl, fr;
+		panFactors(pan, fl, fr);
+		getKernels()->stereo(outputLeft, outputRight, local, remote, samples, fl, fr);
+	}
+}
+
+const char *mixerImplementation() {
+	return getKernels()->name;
+}
+
+bool setMixerImplementation(const char *name) {
+	const Kernels *k = findKernels(name);
+	if (!k)
+		return false;
+	kernels = k;
+	return true;
+}
+
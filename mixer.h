@@ -0,0 +1,50 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+#ifndef MIXER_H
+#define MIXER_H
+
+#include <QtGlobal>
+
+// Sample mixing kernels used by Call.  there are SSE2 and AVX2 versions on
+// x86, picked at run time according to what the CPU supports, and portable
+// versions for everything else.  all versions produce identical output.
+
+// output = (local + remote) / 2, rounded towards zero.  the output must not
+// overlap the input
+void mixToMono(qint16 *, const qint16 *, const qint16 *, long);
+
+// pan is 0 (local left, remote right) to 100 (local right, remote left).
+// the factors are converted to Q15 fixed point, the sum of both being
+// exactly 1.0.  this is not bit-identical to the old division by 100 (up to
+// 2 LSB apart), but both stay within 1.5 LSB of the exact value
+void mixToStereo(qint16 *, qint16 *, const qint16 *, const qint16 *, long, int);
+
+// name of the kernel set in use, for the debug log
+const char *mixerImplementation();
+// forces "scalar", "SSE2" or "AVX2", for benchmarks.  fails if the CPU
+// can't run it
+bool setMixerImplementation(const char *);
+
+#endif
+
@@ -24,9 +24,9 @@
 #include <QByteArray>
 #include <QString>
 #include <lame/lame.h>
-#include <id3/tag.h>
 
 #include "mp3writer.h"
+#include "id3tag.h"
 #include "common.h"
 #include "preferences.h"
 
@@ -56,18 +56,51 @@ bool Mp3Writer::open(const QString &fn, long sr, bool s) {
 	if (!lame)
 		return false;
 
-	bitRate = preferences.get(Pref::OutputFormatMp3Bitrate).toInt();
+	bitRate = prefs->get(Pref::OutputFormatMp3Bitrate).toInt();
+	QString profile = prefs->get(Pref::OutputFormatMp3Profile).toString();
 
 	lame_set_in_samplerate(lame, sampleRate);
 	lame_set_num_channels(lame, stereo ? 2 : 1);
 	lame_set_out_samplerate(lame, sampleRate);
-	// TODO: do we need this?
-	lame_set_bWriteVbrTag(lame, 0);
+	// lame reserves the first frame for a Xing/LAME info frame, which
+	// holds the length and a seek table.  it is filled in when flushing
+	lame_set_bWriteVbrTag(lame, 1);
 	lame_set_mode(lame, stereo ? STEREO : MONO);
-	lame_set_brate(lame, bitRate);
+
+	if (profile == "fast") {
+		// cheapest search that still sounds fine for speech, roughly
+		// half the CPU time of the default
+		lame_set_brate(lame, bitRate);
+		lame_set_quality(lame, 7);
+	} else if (profile == "vbr") {
+		// variable bitrate, with the chosen bitrate as the maximum, so
+		// files never get bigger than with a constant bitrate.  this
+		// needs the seek table in the info frame
+		lame_set_VBR(lame, vbr_mtrh);
+		lame_set_VBR_q(lame, 4);
+		lame_set_VBR_max_bitrate_kbps(lame, bitRate);
+	} else if (profile == "quality") {
+		// average bitrate lets silence and simple passages give bits
+		// to the harder ones.  the file size stays about the same, but
+		// this is the most expensive setting
+		lame_set_VBR(lame, vbr_abr);
+		lame_set_VBR_mean_bitrate_kbps(lame, bitRate);
+		lame_set_quality(lame, 2);
+	} else {
+		// "standard", lame's defaults
+		lame_set_brate(lame, bitRate);
+	}
+
 	if (lame_init_params(lame) == -1)
 		return false;
 
+	// room for the tag is reserved at the start, so that it doesn't have
+	// to be prepended later
+	QByteArray tag = buildId3Tag(tagTime, tagComment);
+	if (!sink.write(tag.constData(), tag.size()))
+		return false;
+	mustWriteTags = false;
+
 	return true;
 }
 
@@ -79,53 +112,32 @@ void Mp3Writer::close() {
 
 	if (!hasFlushed) {
 		debug("WARNING: Mp3Writer::close() called but no flush happened, flushing now");
-		QByteArray dummy1, dummy2;
-		write(dummy1, dummy2, 0, true);
+		write(NULL, NULL, 0, true);
 	}
 
+	if (!writeTags())
+		debug(QString("WARNING: could not write tags to '%1'").arg(file.fileName()));
+
 	AudioFileWriter::close();
-	writeTags();
 }
 
-namespace {
-ID3_Frame *getOrCreateTag(ID3_Tag &tag, ID3_FrameID id) {
-	ID3_Frame *frame = tag.Find(id);
+bool Mp3Writer::writeTags() {
+	// the tag was reserved when opening, so this only overwrites it
 
-	if (!frame) {
-		frame = new ID3_Frame(id);
-		tag.AttachFrame(frame);
-	}
-
-	return frame;
-}
-}
-
-void Mp3Writer::writeTags() {
 	if (!mustWriteTags)
-		return;
+		return true;
 
 	debug("Writing tags to MP3 file");
 
-	QByteArray fn = QFile::encodeName(file.fileName());
-	ID3_Tag tag(fn.constData());
-
-	// NOTE: we don't set ID3FID_TITLE as the file name is already meant to
-	// be a good enough description of the content
-
-	QString str = tagTime.toString("yyyyddMMhhmm");
-	// TODO: the following would be better but doesn't work.  find out why
-	//getOrCreateTag(tag, ID3FID_COMMENT    )->GetField(ID3FN_TEXT)->Set(tagComment.utf16());
-	getOrCreateTag(tag, ID3FID_COMMENT    )->GetField(ID3FN_TEXT)->Set(tagComment.toAscii().constData());
-	getOrCreateTag(tag, ID3FID_CONTENTTYPE)->GetField(ID3FN_TEXT)->Set("(101)Skype Call");
-	getOrCreateTag(tag, ID3FID_YEAR       )->GetField(ID3FN_TEXT)->Set(str.mid(0, 4).toAscii().constData());
-	getOrCreateTag(tag, ID3FID_DATE       )->GetField(ID3FN_TEXT)->Set(str.mid(4, 4).toAscii().constData());
-	getOrCreateTag(tag, ID3FID_TIME       )->GetField(ID3FN_TEXT)->Set(str.mid(8, 4).toAscii().constData());
+	QByteArray tag = buildId3Tag(tagTime, tagComment);
+	if (!sink.writeAt(0, tag.constData(), tag.size()))
+		return false;
 
-	tag.Update();
 	mustWriteTags = false;
+	return true;
 }
 
-bool Mp3Writer::write(QByteArray &left, QByteArray &right, long samples, bool flush) {
+bool Mp3Writer::write(const qint16 *left, const qint16 *right, long samples, bool flush) {
 	int ret;
 	QByteArray output;
 	// rough upper bound formula taken from lame.h
@@ -134,17 +146,9 @@ bool Mp3Writer::write(QByteArray &left, QByteArray &right, long samples, bool fl
 	do {
 		output.resize(size);
 
-		if (stereo) {
-			ret = lame_encode_buffer(lame, reinterpret_cast<const short *>(left.constData()),
-				reinterpret_cast<const short *>(right.constData()), samples,
-				reinterpret_cast<unsigned char *>(output.data()), output.size());
-		} else {
-			// lame.h claims to write to the buffers, even though they're declared const, be safe
-			// TODO: this mixes both channels again!  can lame take only mono samples?
-			ret = lame_encode_buffer(lame, reinterpret_cast<const short *>(left.data()),
-				reinterpret_cast<const short *>(left.data()), samples,
-				reinterpret_cast<unsigned char *>(output.data()), output.size());
-		}
+		// with a single input channel, lame only reads the left buffer
+		ret = lame_encode_buffer(lame, left, stereo ? right : NULL, samples,
+			reinterpret_cast<unsigned char *>(output.data()), output.size());
 
 		if (ret == -1) {
 			// there wasn't enough space in output
@@ -161,14 +165,10 @@ bool Mp3Writer::write(QByteArray &left, QByteArray &right, long samples, bool fl
 	samplesWritten += samples;
 
 	if (ret > 0) {
-		output.truncate(ret);
-		file.write(output);
+		if (!sink.write(output.constData(), ret))
+			return false;
 	}
 
-	left.remove(0, samples * 2);
-	if (stereo)
-		right.remove(0, samples * 2);
-
 	if (!flush)
 		return true;
 
@@ -176,21 +176,39 @@ bool Mp3Writer::write(QByteArray &left, QByteArray &right, long samples, bool fl
 
 	output.resize(10240);
 	ret = lame_encode_flush(lame, reinterpret_cast<unsigned char *>(output.data()), output.size());
-
-	lame_close(lame);
-	lame = NULL;
 	hasFlushed = true;
 
 	if (ret < 0) {
 		debug(QString("Error while flushing MP3 file, code = %1").arg(ret));
+		lame_close(lame);
+		lame = NULL;
 		return false;
 	}
 
-	if (ret > 0) {
-		output.truncate(ret);
-		file.write(output);
+	if (ret > 0 && !sink.write(output.constData(), ret)) {
+		lame_close(lame);
+		lame = NULL;
+		return false;
 	}
 
-	return true;
+	bool b = writeInfoFrame();
+	lame_close(lame);
+	lame = NULL;
+	if (!b)
+		debug(QString("WARNING: could not write the info frame to '%1'").arg(file.fileName()));
+
+	return sink.flush();
+}
+
+bool Mp3Writer::writeInfoFrame() {
+	// the info frame replaces the empty first frame, which directly
+	// follows the ID3 tag
+
+	unsigned char frame[2880];
+	unsigned long size = lame_get_lametag_frame(lame, frame, sizeof(frame));
+	if (size == 0 || size > sizeof(frame))
+		return false;
+
+	return sink.writeAt(id3TagSize, reinterpret_cast<const char *>(frame), size);
 }
 
@@ -24,11 +24,12 @@
 #ifndef MP3WRITER_H
 #define MP3WRITER_H
 
+#include <QByteArray>
+
 #include "common.h"
 #include "writer.h"
 
 class QString;
-class QByteArray;
 typedef struct lame_global_struct lame_global_flags;
 
 class Mp3Writer : public AudioFileWriter {
@@ -38,10 +39,11 @@ public:
 
 	virtual bool open(const QString &, long, bool);
 	virtual void close();
-	virtual bool write(QByteArray &, QByteArray &, long, bool = false);
+	virtual bool write(const qint16 *, const qint16 *, long, bool = false);
 
 private:
-	void writeTags();
+	bool writeTags();
+	bool writeInfoFrame();
 
 private:
 	lame_global_flags *lame;
@@ -0,0 +1,270 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+#include <QThread>
+#include <QSemaphore>
+
+#include "multiwriter.h"
+#include "common.h"
+#include "sampleformat.h"
+
+// MultiWriterThread - calls writeShared() on one writer whenever told to
+
+class MultiWriterThread : public QThread {
+public:
+	MultiWriterThread(AudioFileWriter *w) : writer(w), buffer(NULL), flush(false), result(false), quitting(false) { }
+
+	// starts writing the buffer, which must stay valid until waitForWrite()
+	void write(const SampleBuffer *b, bool f) {
+		buffer = b;
+		flush = f;
+		startSemaphore.release();
+	}
+
+	bool waitForWrite() {
+		doneSemaphore.acquire();
+		return result;
+	}
+
+	void stop() {
+		quitting = true;
+		startSemaphore.release();
+		QThread::wait();
+	}
+
+protected:
+	virtual void run() {
+		for (;;) {
+			startSemaphore.acquire();
+			if (quitting)
+				return;
+			result = writer->writeShared(*buffer, flush);
+			doneSemaphore.release();
+		}
+	}
+
+private:
+	AudioFileWriter *writer;
+	const SampleBuffer *buffer;
+	bool flush;
+	bool result;
+	bool quitting;
+	QSemaphore startSemaphore;
+	QSemaphore doneSemaphore;
+};
+
+// MultiWriter
+
+MultiWriter::MultiWriter(const QStringList &formats) :
+	isOpen(false)
+{
+	QStringList seen;
+	for (int i = 0; i < formats.size(); i++) {
+		QString format = formats.at(i).trimmed();
+		if (format.isEmpty() || seen.contains(format))
+			continue;
+		seen.append(format);
+		writers.append(AudioFileWriter::create(format));
+	}
+}
+
+MultiWriter::~MultiWriter() {
+	if (isOpen) {
+		debug("WARNING: MultiWriter::~MultiWriter(): Files have not been closed, closing them now");
+		close();
+	}
+
+	for (int i = 0; i < writers.size(); i++)
+		delete writers.at(i);
+}
+
+void MultiWriter::setPreferences(BasePreferences *p) {
+	AudioFileWriter::setPreferences(p);
+	for (int i = 0; i < writers.size(); i++)
+		writers.at(i)->setPreferences(p);
+}
+
+void MultiWriter::setTags(const QString &comment, const QDateTime &t) {
+	AudioFileWriter::setTags(comment, t);
+	for (int i = 0; i < writers.size(); i++)
+		writers.at(i)->setTags(comment, t);
+}
+
+bool MultiWriter::open(const QString &fn, long sr, bool s) {
+	// our own file isn't used
+	sampleRate = sr;
+	stereo = s;
+
+	for (int i = 0; i < writers.size(); i++) {
+		AudioFileWriter *writer = writers.at(i);
+		bool b = writer->open(fn, sr, s);
+		if (!b) {
+			debug(QString("WARNING: MultiWriter: could not open '%1', not writing it").arg(writer->fileName()));
+			// it may have created its file before failing, so the caller
+			// still needs to know about it to remove it
+			failedFileNames += writer->fileNames();
+			writer->close();
+			delete writer;
+			writers.removeAt(i--);
+		}
+	}
+
+	if (writers.isEmpty())
+		return false;
+
+	for (int i = 0; i < writers.size(); i++) {
+		alive.append(true);
+		if (i == 0) {
+			// the first one is written by the calling thread
+			threads.append(NULL);
+			continue;
+		}
+		MultiWriterThread *thread = new MultiWriterThread(writers.at(i));
+		thread->start();
+		threads.append(thread);
+	}
+
+	isOpen = true;
+	return true;
+}
+
+void MultiWriter::close() {
+	if (!isOpen) {
+		debug("WARNING: MultiWriter::close() called, but files not open");
+		return;
+	}
+
+	for (int i = 0; i < threads.size(); i++) {
+		if (threads.at(i))
+			threads.at(i)->stop();
+		delete threads.at(i);
+	}
+	threads.clear();
+
+	for (int i = 0; i < writers.size(); i++)
+		writers.at(i)->close();
+
+	isOpen = false;
+}
+
+bool MultiWriter::write(const qint16 *left, const qint16 *right, long samples, bool flush) {
+	SampleBuffer buffer(left, right, samples);
+
+	// do each conversion once, if any of the writers can use it
+	int conversions = 0;
+	for (int i = 0; i < writers.size(); i++)
+		if (alive.at(i))
+			conversions |= writers.at(i)->sharedConversions();
+
+	if (stereo && (conversions & Interleaved)) {
+		interleaved.resize(samples * 4);
+		interleave(reinterpret_cast<qint16 *>(interleaved.data()), left, right, samples);
+		buffer.interleaved = reinterpret_cast<const qint16 *>(interleaved.constData());
+	}
+
+	if (conversions & Float) {
+		leftFloat.resize(samples * sizeof(float));
+		s16ToFloat(reinterpret_cast<float *>(leftFloat.data()), left, samples);
+		buffer.leftFloat = reinterpret_cast<const float *>(leftFloat.constData());
+		if (stereo) {
+			rightFloat.resize(samples * sizeof(float));
+			s16ToFloat(reinterpret_cast<float *>(rightFloat.data()), right, samples);
+			buffer.rightFloat = reinterpret_cast<const float *>(rightFloat.constData());
+		}
+	}
+
+	for (int i = 1; i < writers.size(); i++)
+		if (alive.at(i))
+			threads.at(i)->write(&buffer, flush);
+
+	if (alive.at(0) && !writers.at(0)->writeShared(buffer, flush))
+		fail(0);
+
+	for (int i = 1; i < writers.size(); i++)
+		if (alive.at(i) && !threads.at(i)->waitForWrite())
+			fail(i);
+
+	samplesWritten += samples;
+
+	if (!alive.contains(true))
+		return false;
+
+	// backwards, since this removes them
+	for (int i = writers.size() - 1; i >= 0; i--)
+		if (!alive.at(i))
+			drop(i);
+
+	return true;
+}
+
+void MultiWriter::fail(int i) {
+	debug(QString("WARNING: MultiWriter: error while writing '%1', not writing it anymore").arg(writers.at(i)->fileName()));
+	alive[i] = false;
+}
+
+void MultiWriter::drop(int i) {
+	// the thread is idle between writes.  if the first writer goes, the
+	// next one takes its place on the calling thread, and its own thread
+	// just stays idle until close()
+	if (threads.at(i)) {
+		threads.at(i)->stop();
+		delete threads.at(i);
+	}
+	AudioFileWriter *writer = writers.at(i);
+	writer->close();
+	lostFileNames += writer->fileNames();
+	delete writer;
+
+	writers.removeAt(i);
+	threads.removeAt(i);
+	alive.removeAt(i);
+}
+
+QString MultiWriter::fileName() const {
+	if (!writers.isEmpty())
+		return writers.first()->fileName();
+	// when none could be opened, this is what the error is reported for
+	return failedFileNames.isEmpty() ? QString() : failedFileNames.first();
+}
+
+QStringList MultiWriter::fileNames() const {
+	QStringList list;
+	for (int i = 0; i < writers.size(); i++)
+		list += writers.at(i)->fileNames();
+	list += failedFileNames;
+	return list;
+}
+
+QStringList MultiWriter::takeLostFileNames() {
+	QStringList list = lostFileNames;
+	lostFileNames.clear();
+	return list;
+}
+
+qint64 MultiWriter::size() const {
+	qint64 max = 0;
+	for (int i = 0; i < writers.size(); i++)
+		max = qMax(max, writers.at(i)->size());
+	return max;
+}
+
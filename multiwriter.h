@@ -0,0 +1,82 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+#ifndef MULTIWRITER_H
+#define MULTIWRITER_H
+
+#include <QByteArray>
+#include <QList>
+#include <QStringList>
+
+#include "common.h"
+#include "writer.h"
+
+class MultiWriterThread;
+
+// writes the same samples to several files in different formats.  the
+// conversions the writers share are done once, then all writers encode in
+// parallel, each on its own thread except for the first one, which uses the
+// calling thread.  a writer that fails is dropped and its files are handed
+// to the caller through takeLostFileNames(), the others carry on.  only when
+// all have failed does writing fail
+
+class MultiWriter : public AudioFileWriter {
+public:
+	MultiWriter(const QStringList &);
+	virtual ~MultiWriter();
+
+	virtual void setPreferences(BasePreferences *);
+	virtual void setTags(const QString &, const QDateTime &);
+	virtual bool open(const QString &, long, bool);
+	virtual void close();
+	virtual bool write(const qint16 *, const qint16 *, long, bool = false);
+
+	virtual QString fileName() const;
+	virtual QStringList fileNames() const;
+	virtual QStringList takeLostFileNames();
+	// the size of the largest file
+	virtual qint64 size() const;
+
+private:
+	void fail(int);
+	void drop(int);
+
+private:
+	QList<AudioFileWriter *> writers;
+	QList<MultiWriterThread *> threads;
+	// writers that are still working
+	QList<bool> alive;
+	// files of the writers that could not be opened
+	QStringList failedFileNames;
+	// files of the writers dropped while writing
+	QStringList lostFileNames;
+	bool isOpen;
+	QByteArray interleaved;
+	QByteArray leftFloat;
+	QByteArray rightFloat;
+
+	DISABLE_COPY_AND_ASSIGNMENT(MultiWriter);
+};
+
+#endif
+
@@ -0,0 +1,156 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+#include <QByteArray>
+#include <unistd.h>
+
+#include "oggindex.h"
+#include "common.h"
+
+namespace {
+void appendUInt32(QByteArray &array, quint32 i) {
+	array.append((char)i);
+	array.append((char)(i >> 8));
+	array.append((char)(i >> 16));
+	array.append((char)(i >> 24));
+}
+
+void appendUInt64(QByteArray &array, quint64 i) {
+	appendUInt32(array, (quint32)i);
+	appendUInt32(array, (quint32)(i >> 32));
+}
+
+// where the count is in the header
+const off_t countOffset = 20;
+}
+
+OggIndex::OggIndex() :
+	rate(0),
+	preSkip(0),
+	interval(0),
+	next(0),
+	last(0),
+	count(0)
+{
+}
+
+void OggIndex::start(const QString &fn, long r, long p, int i) {
+	name = fn;
+	rate = r;
+	preSkip = p;
+	interval = i;
+	next = p;
+	last = 0;
+	count = 0;
+	pending.clear();
+
+	if (!interval)
+		return;
+
+	QByteArray data("SCRX");
+	appendUInt32(data, 1);
+	appendUInt32(data, rate);
+	appendUInt32(data, preSkip);
+	appendUInt32(data, interval);
+	appendUInt32(data, count);
+
+	// unbuffered, so that the entries are in the file before the count
+	// including them
+	file.setFileName(name);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Unbuffered) || file.write(data) != data.size())
+		fail();
+}
+
+void OggIndex::addPage(qint64 granule, qint64 offset) {
+	if (!file.isOpen() || granule < 0)
+		return;
+
+	// this page holds the samples after the last one.  a long page may
+	// hold several entry points, and then gets several entries, so that
+	// entry k is always at k * interval
+	while (granule > next) {
+		Entry entry;
+		entry.granule = last;
+		entry.offset = offset;
+		pending.append(entry);
+		next += (qint64)interval * rate;
+	}
+
+	last = granule;
+}
+
+void OggIndex::flush(qint64 written) {
+	if (!file.isOpen())
+		return;
+
+	int n = 0;
+	while (n < pending.size() && pending.at(n).offset < written)
+		n++;
+	writeEntries(n);
+}
+
+void OggIndex::writeEntries(int n) {
+	if (!n)
+		return;
+
+	// the entries are appended, then the count is patched in place, which
+	// leaves the position for appending alone
+	QByteArray data;
+	for (int i = 0; i < n; i++) {
+		appendUInt64(data, pending.at(i).granule);
+		appendUInt64(data, pending.at(i).offset);
+	}
+	if (file.write(data) != data.size()) {
+		fail();
+		return;
+	}
+
+	QByteArray countData;
+	appendUInt32(countData, count + n);
+	if (pwrite(file.handle(), countData.constData(), countData.size(), countOffset) != countData.size()) {
+		fail();
+		return;
+	}
+
+	count += n;
+	for (int i = 0; i < n; i++)
+		pending.removeFirst();
+}
+
+void OggIndex::close() {
+	if (!file.isOpen())
+		return;
+
+	writeEntries(pending.size());
+	if (!file.isOpen())
+		return;
+
+	file.close();
+	debug(QString("Wrote seek index '%1' with %2 entries").arg(name).arg(count));
+}
+
+void OggIndex::fail() {
+	debug(QString("WARNING: could not write the seek index '%1', not writing it anymore").arg(name));
+	file.close();
+}
+
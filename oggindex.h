@@ -0,0 +1,100 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+#ifndef OGGINDEX_H
+#define OGGINDEX_H
+
+#include <QFile>
+#include <QList>
+#include <QString>
+#include <QtGlobal>
+
+#include "common.h"
+
+// a seek index for an Ogg file, written next to it while its pages are
+// written.  new entries are appended once the pages they point to have been
+// written to the Ogg file, and the count is patched in afterwards, so after
+// a crash the index still covers what was written up to then.  there is one
+// entry every so many seconds, so the entry for a given time is found by a
+// division.  entry k is the start of the page that
+// holds the sample at k * interval, together with the granule position at
+// that point.  decoders need some pre-roll before it, like for any seek
+//
+// the file is little endian:
+//
+//	"SCRX"            magic
+//	u32 1             version
+//	u32 rate          granule positions per second
+//	u32 preSkip       granule position of time 0
+//	u32 interval      seconds between entries
+//	u32 count         number of entries
+//	count times:
+//	  u64 granule     granule position where the page starts
+//	  u64 offset      byte offset of the page in the Ogg file
+
+class OggIndex {
+public:
+	OggIndex();
+
+	// creates the file and writes the header.  an interval of 0 disables
+	// the index
+	void start(const QString &, long, long, int);
+	bool isEnabled() const { return interval != 0; }
+	// called for each page, before it is written at the given offset.  a
+	// negative granule position means no packet ends on the page
+	void addPage(qint64, qint64);
+	// writes the new entries pointing before the given offset, up to
+	// which the Ogg file has been written
+	void flush(qint64);
+	// writes all remaining entries
+	void close();
+	const QString &fileName() const { return name; }
+
+private:
+	struct Entry {
+		qint64 granule;
+		qint64 offset;
+	};
+
+	void writeEntries(int);
+	void fail();
+
+private:
+	QString name;
+	QFile file;
+	long rate;
+	long preSkip;
+	int interval;
+	// granule position of the next entry
+	qint64 next;
+	// granule position at the end of the last page
+	qint64 last;
+	// entries in the file, and the ones not written yet
+	quint32 count;
+	QList<Entry> pending;
+
+	DISABLE_COPY_AND_ASSIGNMENT(OggIndex);
+};
+
+#endif
+
@@ -0,0 +1,288 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+// Note: this writes Ogg Opus files as described in RFC 7845.  the first page
+// holds the OpusHead packet and the second one the OpusTags packet, followed
+// by one Opus packet per 20 ms frame.  granule positions always count samples
+// at 48 kHz, whatever the input rate is
+
+#include <QByteArray>
+#include <QString>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <ogg/ogg.h>
+#include <opus/opus.h>
+
+#include "opuswriter.h"
+#include "common.h"
+#include "preferences.h"
+#include "sampleformat.h"
+
+struct OpusWriterPrivateData {
+	OpusEncoder *encoder;
+	ogg_stream_state os;
+	ogg_page og;
+	ogg_packet op;
+	int channels;
+	long frameSize;
+	// samples at 48 kHz to skip at the start, for the encoder's lookahead
+	long preSkip;
+	// samples at 48 kHz that have been encoded so far
+	qint64 encoded;
+	ogg_int64_t packetNo;
+	// interleaved samples that don't make a full frame yet
+	QByteArray pending;
+	QByteArray interleaved;
+	QByteArray packet;
+};
+
+namespace {
+// largest packet recommended by the libopus docs
+const int maxPacketSize = 4000;
+
+void appendUInt16(QByteArray &array, int i) {
+	array.append((char)i);
+	array.append((char)(i >> 8));
+}
+
+void appendUInt32(QByteArray &array, long i) {
+	array.append((char)i);
+	array.append((char)(i >> 8));
+	array.append((char)(i >> 16));
+	array.append((char)(i >> 24));
+}
+
+void appendString(QByteArray &array, const QByteArray &s) {
+	appendUInt32(array, s.size());
+	array.append(s);
+}
+}
+
+OpusWriter::OpusWriter() :
+	pd(NULL),
+	hasFlushed(false)
+{
+}
+
+OpusWriter::~OpusWriter() {
+	if (file.isOpen()) {
+		debug("WARNING: OpusWriter::~OpusWriter(): File has not been closed, closing it now");
+		close();
+	}
+
+	if (pd) {
+		ogg_stream_clear(&pd->os);
+		if (pd->encoder)
+			opus_encoder_destroy(pd->encoder);
+		delete pd;
+	}
+}
+
+bool OpusWriter::open(const QString &fn, long sr, bool s) {
+	bool b = AudioFileWriter::open(fn + ".opus", sr, s);
+
+	if (!b)
+		return false;
+
+	int bitRate = prefs->get(Pref::OutputFormatOpusBitrate).toInt();
+
+	pd = new OpusWriterPrivateData;
+	pd->channels = stereo ? 2 : 1;
+	pd->frameSize = sampleRate / 50;
+	pd->encoded = 0;
+	pd->packetNo = 0;
+	pd->packet.resize(maxPacketSize);
+
+	std::srand(std::time(NULL));
+	ogg_stream_init(&pd->os, std::rand());
+
+	// only 8, 12, 16, 24 and 48 kHz are accepted
+	int error;
+	pd->encoder = opus_encoder_create(sampleRate, pd->channels, OPUS_APPLICATION_VOIP, &error);
+	if (!pd->encoder) {
+		debug(QString("OpusWriter: cannot create encoder: %1").arg(opus_strerror(error)));
+		return false;
+	}
+
+	opus_encoder_ctl(pd->encoder, OPUS_SET_BITRATE(bitRate * 1000));
+	opus_encoder_ctl(pd->encoder, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+
+	opus_int32 lookahead;
+	if (opus_encoder_ctl(pd->encoder, OPUS_GET_LOOKAHEAD(&lookahead)) != OPUS_OK)
+		lookahead = 0;
+	pd->preSkip = lookahead * (48000 / sampleRate);
+
+	index.start(file.fileName() + ".idx", 48000, pd->preSkip, prefs->get(Pref::OutputOggIndex).toInt());
+
+	QByteArray head;
+	head.append("OpusHead");
+	head.append((char)1);             // version
+	head.append((char)pd->channels);  // channel count
+	appendUInt16(head, pd->preSkip);  // pre-skip
+	appendUInt32(head, sampleRate);   // original input sample rate
+	appendUInt16(head, 0);            // output gain
+	head.append((char)0);             // channel mapping family
+
+	QByteArray tags;
+	tags.append("OpusTags");
+	appendString(tags, opus_get_version_string());
+	appendUInt32(tags, 3);
+	appendString(tags, ("COMMENT=" + tagComment).toUtf8());
+	appendString(tags, ("DATE=" + tagTime.toString("yyyy-MM-dd hh:mm")).toUtf8());
+	appendString(tags, "GENRE=Speech (Skype Call)");
+
+	QByteArray *headers[2] = { &head, &tags };
+	for (int i = 0; i < 2; i++) {
+		pd->op.packet = reinterpret_cast<unsigned char *>(headers[i]->data());
+		pd->op.bytes = headers[i]->size();
+		pd->op.b_o_s = i == 0;
+		pd->op.e_o_s = 0;
+		pd->op.granulepos = 0;
+		pd->op.packetno = pd->packetNo++;
+		ogg_stream_packetin(&pd->os, &pd->op);
+
+		// each header goes on its own page
+		if (!writePages(true))
+			return false;
+	}
+
+	return true;
+}
+
+void OpusWriter::close() {
+	if (!file.isOpen()) {
+		debug("WARNING: OpusWriter::close() called, but file not open");
+		return;
+	}
+
+	if (!hasFlushed) {
+		debug("WARNING: OpusWriter::close() called but no flush happened, flushing now");
+		write(NULL, NULL, 0, true);
+	}
+
+	index.close();
+
+	AudioFileWriter::close();
+}
+
+QStringList OpusWriter::fileNames() const {
+	QStringList list(fileName());
+	if (index.isEnabled())
+		list.append(index.fileName());
+	return list;
+}
+
+bool OpusWriter::write(const qint16 *left, const qint16 *right, long samples, bool flush) {
+	return writeShared(SampleBuffer(left, right, samples), flush);
+}
+
+bool OpusWriter::writeShared(const SampleBuffer &b, bool flush) {
+	if (!pd || !pd->encoder)
+		return false;
+
+	long samples = b.samples;
+
+	if (stereo && b.interleaved) {
+		pd->pending.append(reinterpret_cast<const char *>(b.interleaved), samples * 4);
+	} else if (stereo) {
+		pd->interleaved.resize(samples * 4);
+		interleave(reinterpret_cast<qint16 *>(pd->interleaved.data()), b.left, b.right, samples);
+		pd->pending.append(pd->interleaved);
+	} else {
+		pd->pending.append(reinterpret_cast<const char *>(b.left), samples * 2);
+	}
+
+	samplesWritten += samples;
+
+	long frameBytes = pd->frameSize * pd->channels * 2;
+	long frames = pd->pending.size() / frameBytes;
+
+	if (flush) {
+		// the encoder lags behind by its lookahead, so enough silence is
+		// appended to get all samples out of it.  the granule position
+		// of the last page then cuts off what is too much
+		long frame48k = pd->frameSize * (48000 / sampleRate);
+		qint64 needed = pd->preSkip + samplesWritten * (48000 / sampleRate) - pd->encoded;
+		frames = (needed + frame48k - 1) / frame48k;
+		if (frames < 1)
+			frames = 1;
+		pd->pending.append(QByteArray(frames * frameBytes - pd->pending.size(), 0));
+		hasFlushed = true;
+	}
+
+	const qint16 *data = reinterpret_cast<const qint16 *>(pd->pending.constData());
+	for (long i = 0; i < frames; i++) {
+		if (!encodeFrame(data, flush && i == frames - 1))
+			return false;
+		data += pd->frameSize * pd->channels;
+	}
+
+	pd->pending.remove(0, frames * frameBytes);
+
+	if (!writePages(flush))
+		return false;
+
+	if (flush && !sink.flush())
+		return false;
+
+	index.flush(sink.flushedSize());
+	return true;
+}
+
+bool OpusWriter::encodeFrame(const qint16 *pcm, bool last) {
+	unsigned char *packet = reinterpret_cast<unsigned char *>(pd->packet.data());
+
+	int bytes = opus_encode(pd->encoder, pcm, pd->frameSize, packet, maxPacketSize);
+	if (bytes < 0) {
+		debug(QString("OpusWriter: encoder error: %1").arg(opus_strerror(bytes)));
+		return false;
+	}
+
+	pd->encoded += pd->frameSize * (48000 / sampleRate);
+
+	pd->op.packet = packet;
+	pd->op.bytes = bytes;
+	pd->op.b_o_s = 0;
+	pd->op.e_o_s = last;
+	if (last)
+		pd->op.granulepos = pd->preSkip + samplesWritten * (48000 / sampleRate);
+	else
+		pd->op.granulepos = pd->encoded;
+	pd->op.packetno = pd->packetNo++;
+	ogg_stream_packetin(&pd->os, &pd->op);
+
+	return writePages(false);
+}
+
+bool OpusWriter::writePages(bool flush) {
+	while (flush ? ogg_stream_flush(&pd->os, &pd->og) : ogg_stream_pageout(&pd->os, &pd->og)) {
+		index.addPage(ogg_page_granulepos(&pd->og), sink.size());
+		if (!sink.write((const char *)pd->og.header, pd->og.header_len) ||
+				!sink.write((const char *)pd->og.body, pd->og.body_len))
+			return false;
+	}
+
+	return true;
+}
+
@@ -39,9 +39,9 @@
 #include <QFileIconProvider>
 #include <QFileDialog>
 #include <QTabWidget>
-#include <ctime>
 
 #include "preferences.h"
+#include "filename.h"
 #include "smartwidgets.h"
 #include "common.h"
 #include "recorder.h"
@@ -57,52 +57,13 @@ QString getOutputPath() {
 	return path;
 }
 
-namespace {
-QString escape(const QString &s) {
-	QString out = s;
-	out.replace('%', "%%");
-	out.replace('/', '_');
-	return out;
-}
-}
-
 QString getFileName(const QString &skypeName, const QString &displayName,
-	const QString &mySkypeName, const QString &myDisplayName, const QDateTime &timestamp, const QString &pat)
+	const QString &mySkypeName, const QString &myDisplayName, const QDateTime &timestamp, const QString &pat,
+	int segment)
 {
 	QString pattern = pat.isEmpty() ? preferences.get(Pref::OutputPattern).toString() : pat;
-	QString fileName;
-
-	for (int i = 0; i < pattern.size(); i++) {
-		if (pattern.at(i) == QChar('&') && i + 1 < pattern.size()) {
-			i++;
-			if (pattern.at(i) == QChar('s'))
-				fileName += escape(skypeName);
-			else if (pattern.at(i) == QChar('d'))
-				fileName += escape(displayName);
-			else if (pattern.at(i) == QChar('t'))
-				fileName += escape(mySkypeName);
-			else if (pattern.at(i) == QChar('e'))
-				fileName += escape(myDisplayName);
-			else if (pattern.at(i) == QChar('&'))
-				fileName += QChar('&');
-			else {
-				fileName += QChar('&');
-				fileName += pattern.at(i);
-			}
-		} else {
-			fileName += pattern.at(i);
-		}
-	}
-
-	// TODO: uhm, does QT provide any time formatting the strftime() way?
-	char *buf = new char[fileName.size() + 1024];
-	time_t t = timestamp.toTime_t();
-	struct tm *tm = std::localtime(&t);
-	std::strftime(buf, fileName.size() + 1024, fileName.toUtf8().constData(), tm);
-	fileName = QString::fromLocal8Bit(buf);
-	delete[] buf;
-
-	return getOutputPath() + '/' + fileName;
+	return expandFileName(getOutputPath(), pattern, skypeName, displayName, mySkypeName, myDisplayName,
+		timestamp, segment);
 }
 
 // preferences dialog
@@ -187,6 +148,8 @@ QWidget *PreferencesDialog::createFormatTab() {
 	formatWidget->addItem("WAV PCM", "wav");
 	formatWidget->addItem("MP3", "mp3");
 	formatWidget->addItem("Ogg Vorbis", "vorbis");
+	formatWidget->addItem("Opus", "opus");
+	formatWidget->addItem("FLAC", "flac");
 	formatWidget->setupDone();
 	connect(formatWidget, SIGNAL(currentIndexChanged(int)), this, SLOT(updateFormatSettings()));
 	grid->addWidget(label, 0, 0);
@@ -215,6 +178,19 @@ QWidget *PreferencesDialog::createFormatTab() {
 	grid->addWidget(label, 1, 0);
 	grid->addWidget(combo, 1, 1);
 
+	label = new QLabel("MP3 enco&ding:");
+	combo = new SmartComboBox(preferences.get(Pref::OutputFormatMp3Profile));
+	label->setBuddy(combo);
+	combo->addItem("Fast (less CPU usage)", "fast");
+	combo->addItem("Standard (recommended)", "standard");
+	combo->addItem("Variable bitrate (smaller files)", "vbr");
+	combo->addItem("High quality (more CPU usage)", "quality");
+	combo->setupDone();
+	mp3Settings.append(label);
+	mp3Settings.append(combo);
+	grid->addWidget(label, 2, 0);
+	grid->addWidget(combo, 2, 1);
+
 	label = new QLabel("Ogg Vorbis &quality:");
 	combo = new SmartComboBox(preferences.get(Pref::OutputFormatVorbisQuality));
 	label->setBuddy(combo);
@@ -233,8 +209,42 @@ QWidget *PreferencesDialog::createFormatTab() {
 	combo->setupDone();
 	vorbisSettings.append(label);
 	vorbisSettings.append(combo);
-	grid->addWidget(label, 2, 0);
-	grid->addWidget(combo, 2, 1);
+	grid->addWidget(label, 3, 0);
+	grid->addWidget(combo, 3, 1);
+
+	label = new QLabel("Op&us bitrate:");
+	combo = new SmartComboBox(preferences.get(Pref::OutputFormatOpusBitrate));
+	label->setBuddy(combo);
+	combo->addItem("8 kbps", 8);
+	combo->addItem("12 kbps", 12);
+	combo->addItem("16 kbps (recommended for mono)", 16);
+	combo->addItem("24 kbps (recommended for stereo)", 24);
+	combo->addItem("32 kbps", 32);
+	combo->addItem("48 kbps", 48);
+	combo->addItem("64 kbps", 64);
+	combo->setupDone();
+	opusSettings.append(label);
+	opusSettings.append(combo);
+	grid->addWidget(label, 4, 0);
+	grid->addWidget(combo, 4, 1);
+
+	label = new QLabel("FLAC compression &level:");
+	combo = new SmartComboBox(preferences.get(Pref::OutputFormatFlacLevel));
+	label->setBuddy(combo);
+	combo->addItem("Level 0 (fastest)", 0);
+	combo->addItem("Level 1", 1);
+	combo->addItem("Level 2", 2);
+	combo->addItem("Level 3", 3);
+	combo->addItem("Level 4", 4);
+	combo->addItem("Level 5 (recommended)", 5);
+	combo->addItem("Level 6", 6);
+	combo->addItem("Level 7", 7);
+	combo->addItem("Level 8 (smallest files)", 8);
+	combo->setupDone();
+	flacSettings.append(label);
+	flacSettings.append(combo);
+	grid->addWidget(label, 5, 0);
+	grid->addWidget(combo, 5, 1);
 
 	vbox->addLayout(grid);
 
@@ -258,9 +268,19 @@ QWidget *PreferencesDialog::createFormatTab() {
 	vbox->addWidget(stereoMixLabel);
 	vbox->addWidget(slider);
 
+	check = new SmartCheckBox("Record to &WAV during calls and encode afterwards.  This uses\n"
+		"less CPU during calls, but needs more disk space", preferences.get(Pref::OutputSpool));
+	mp3Settings.append(check);
+	vorbisSettings.append(check);
+	opusSettings.append(check);
+	flacSettings.append(check);
+	vbox->addWidget(check);
+
 	check = new SmartCheckBox("Save call &information in files", preferences.get(Pref::OutputSaveTags));
 	mp3Settings.append(check);
 	vorbisSettings.append(check);
+	opusSettings.append(check);
+	flacSettings.append(check);
 	vbox->addWidget(check);
 
 	vbox->addStretch();
@@ -318,6 +338,12 @@ void PreferencesDialog::updateFormatSettings() {
 	if (v != "vorbis")
 		for (int i = 0; i < vorbisSettings.size(); i++)
 			vorbisSettings.at(i)->setEnabled(false);
+	if (v != "opus")
+		for (int i = 0; i < opusSettings.size(); i++)
+			opusSettings.at(i)->setEnabled(false);
+	if (v != "flac")
+		for (int i = 0; i < flacSettings.size(); i++)
+			flacSettings.at(i)->setEnabled(false);
 	// enable
 	if (v == "mp3")
 		for (int i = 0; i < mp3Settings.size(); i++)
@@ -325,6 +351,12 @@ void PreferencesDialog::updateFormatSettings() {
 	if (v == "vorbis")
 		for (int i = 0; i < vorbisSettings.size(); i++)
 			vorbisSettings.at(i)->setEnabled(true);
+	if (v == "opus")
+		for (int i = 0; i < opusSettings.size(); i++)
+			opusSettings.at(i)->setEnabled(true);
+	if (v == "flac")
+		for (int i = 0; i < flacSettings.size(); i++)
+			flacSettings.at(i)->setEnabled(true);
 }
 
 void PreferencesDialog::updateStereoSettings(bool stereo) {
@@ -385,6 +417,7 @@ void PreferencesDialog::updatePatternToolTip(const QString &pattern) {
 	X("&d"     , "The remote display name")
 	X("&t"     , "Your skype name")
 	X("&e"     , "Your display name")
+	X("&n"     , "The segment number, when long calls are split")
 	X("&&"     , "Literal & character")
 	X("%Y"     , "Year")
 	X("%A / %a", "Full / abbreviated weekday name")
@@ -786,6 +819,12 @@ void BasePreferences::clear() {
 	prefs.clear();
 }
 
+void BasePreferences::copyFrom(const BasePreferences &other) {
+	clear();
+	for (int i = 0; i < other.prefs.size(); i++)
+		prefs.append(new Preference(*other.prefs.at(i)));
+}
+
 // preferences
 
 void Preferences::setPerCallerPreference(const QString &sn, int mode) {
@@ -100,6 +100,8 @@ public:
 	void remove(const QString &);
 	bool exists(const QString &) const;
 	void clear();
+	// replaces all preferences with copies of the given ones
+	void copyFrom(const BasePreferences &);
 
 	int count() const { return prefs.size(); }
 
@@ -155,6 +157,8 @@ private:
 private:
 	QList<QWidget *> mp3Settings;
 	QList<QWidget *> vorbisSettings;
+	QList<QWidget *> flacSettings;
+	QList<QWidget *> opusSettings;
 	QList<QWidget *> stereoSettings;
 	SmartLineEdit *outputPathEdit;
 	SmartComboBox *formatWidget;
@@ -214,7 +218,7 @@ private:
 extern Preferences preferences;
 extern QString getOutputPath();
 extern QString getFileName(const QString &, const QString &, const QString &,
-	const QString &, const QDateTime &, const QString & = QString());
+	const QString &, const QDateTime &, const QString & = QString(), int = 0);
 
 // preference constants
 
@@ -230,10 +234,29 @@ X(OutputPath,                  output.path)
 X(OutputPattern,               output.pattern)
 X(OutputFormat,                output.format)
 X(OutputFormatMp3Bitrate,      output.format.mp3.bitrate)
+X(OutputFormatMp3Profile,      output.format.mp3.profile)
 X(OutputFormatVorbisQuality,   output.format.vorbis.quality)
+X(OutputFormatFlacLevel,       output.format.flac.level)
+X(OutputFormatOpusBitrate,     output.format.opus.bitrate)
+X(OutputFormatExtra,           output.format.extra)
 X(OutputStereo,                output.stereo)
 X(OutputStereoMix,             output.stereo.mix)
 X(OutputSaveTags,              output.savetags)
+X(OutputSpool,                 output.spool)
+X(OutputSegmentMinutes,        output.segment.minutes)
+X(OutputSegmentSize,           output.segment.size)
+X(OutputOggIndex,              output.ogg.index)
+X(OutputWavHeaderInterval,     output.format.wav.headerinterval)
+X(OutputDurability,            output.durability)
+X(OutputDurabilityInterval,    output.durability.interval)
+X(OutputBufferSize,            output.buffer.size)
+X(OutputBufferFlushInterval,   output.buffer.flushinterval)
+X(OutputIoBackend,             output.io.backend)
+X(OutputIoInFlight,            output.io.inflight)
+X(OutputBatchLatency,          output.batch.latency)
+X(OutputBatchMin,              output.batch.min)
+X(OutputBatchMax,              output.batch.max)
+X(OutputBatchAdaptive,         output.batch.adaptive)
 X(SuppressLegalInformation,    suppress.legalinformation)
 X(SuppressFirstRunInformation, suppress.firstruninformation)
 X(PreferencesVersion,          preferences.version)
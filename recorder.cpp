@@ -42,6 +42,10 @@
 	#include "skype-dbus.h"
 #endif
 #include "call.h"
+#include "encoder.h"
+#include "iobackend.h"
+#include "mixer.h"
+#include "transcoder.h"
 
 Recorder::Recorder(int &argc, char **argv) :
 	QApplication(argc, argv)
@@ -58,10 +62,15 @@ Recorder::Recorder(int &argc, char **argv) :
 	}
 
 	loadPreferences();
+	debug(QString("Using %1 mixing kernels").arg(mixerImplementation()));
+	IoPool::instance();
 
 	setupGUI();
 	setupSkype();
 	setupCallHandler();
+
+	// picks up the jobs left over from the last time
+	TranscodeQueue::instance();
 }
 
 Recorder::~Recorder() {
@@ -72,6 +81,9 @@ Recorder::~Recorder() {
 
 	delete preferencesDialog;
 	delete callHandler;
+	TranscodeQueue::destroy();
+	EncoderPool::destroy();
+	IoPool::destroy();
 	delete skype;
 	delete trayIcon;
 }
@@ -143,12 +155,31 @@ void Recorder::loadPreferences() {
 	X(Pref::AutoRecordNo,                "");            // comma separated skypenames to never record
 	X(Pref::OutputPath,                  "~/Skype Calls");
 	X(Pref::OutputPattern,               "Calls with &s/Call with &s, %a %b %d %Y, %H:%M:%S");
-	X(Pref::OutputFormat,                "mp3");         // "mp3", "vorbis" or "wav"
+	X(Pref::OutputFormat,                "mp3");         // "mp3", "vorbis", "opus", "flac" or "wav"
 	X(Pref::OutputFormatMp3Bitrate,      64);
+	X(Pref::OutputFormatMp3Profile,      "standard");    // "fast", "standard", "vbr" or "quality"
 	X(Pref::OutputFormatVorbisQuality,   3);
+	X(Pref::OutputFormatFlacLevel,       5);             // 0 .. 8
+	X(Pref::OutputFormatOpusBitrate,     24);
+	X(Pref::OutputFormatExtra,           "");            // comma separated formats to write in addition
 	X(Pref::OutputStereo,                true);
 	X(Pref::OutputStereoMix,             0);             // 0 .. 100
 	X(Pref::OutputSaveTags,              true);
+	X(Pref::OutputSpool,                 false);
+	X(Pref::OutputSegmentMinutes,        0);             // 0 = no time limit per file
+	X(Pref::OutputSegmentSize,           0);             // MiB, 0 = no size limit per file
+	X(Pref::OutputOggIndex,              0);             // seconds between seek index entries, 0 = no index
+	X(Pref::OutputWavHeaderInterval,     1);             // seconds, 0 = only when closing
+	X(Pref::OutputDurability,            "none");        // "none", "periodic" or "header"
+	X(Pref::OutputDurabilityInterval,    10);            // seconds, for "periodic", and "header" without periodic WAV headers
+	X(Pref::OutputBufferSize,            256);           // KiB
+	X(Pref::OutputBufferFlushInterval,   5);             // seconds, 0 = only when full
+	X(Pref::OutputIoBackend,             "auto");        // "auto", "uring", "threads" or "sync"
+	X(Pref::OutputIoInFlight,            4);
+	X(Pref::OutputBatchLatency,          100);           // milliseconds
+	X(Pref::OutputBatchMin,              20);            // milliseconds
+	X(Pref::OutputBatchMax,              2000);          // milliseconds
+	X(Pref::OutputBatchAdaptive,         true);
 	X(Pref::SuppressLegalInformation,    false);
 	X(Pref::SuppressFirstRunInformation, false);
 	X(Pref::PreferencesVersion,          2);
@@ -221,29 +252,145 @@ bool Recorder::sanatizePreferencesGeneric() {
 	}
 
 	s = preferences.get(Pref::OutputFormat).toString();
-	if (s != "mp3" && s != "vorbis" && s != "wav") {
+	if (s != "mp3" && s != "vorbis" && s != "opus" && s != "flac" && s != "wav") {
 		preferences.get(Pref::OutputFormat).set("mp3");
 		didSomething = true;
 	}
 
+	{
+		QStringList formats = preferences.get(Pref::OutputFormatExtra).toList();
+		QStringList valid;
+		for (int j = 0; j < formats.size(); j++) {
+			s = formats.at(j);
+			if ((s == "mp3" || s == "vorbis" || s == "opus" || s == "flac" || s == "wav") && !valid.contains(s))
+				valid.append(s);
+		}
+		if (valid != formats) {
+			preferences.get(Pref::OutputFormatExtra).set(valid);
+			didSomething = true;
+		}
+	}
+
 	i = preferences.get(Pref::OutputFormatMp3Bitrate).toInt();
 	if (i < 8 || (i >= 8 && i <= 64 && i % 8 != 0) || (i > 64 && i <= 160 && i % 16 != 0) || i > 160) {
 		preferences.get(Pref::OutputFormatMp3Bitrate).set(64);
 		didSomething = true;
 	}
 
+	s = preferences.get(Pref::OutputFormatMp3Profile).toString();
+	if (s != "fast" && s != "standard" && s != "vbr" && s != "quality") {
+		preferences.get(Pref::OutputFormatMp3Profile).set("standard");
+		didSomething = true;
+	}
+
 	i = preferences.get(Pref::OutputFormatVorbisQuality).toInt();
 	if (i < -1 || i > 10) {
 		preferences.get(Pref::OutputFormatVorbisQuality).set(3);
 		didSomething = true;
 	}
 
+	i = preferences.get(Pref::OutputFormatFlacLevel).toInt();
+	if (i < 0 || i > 8) {
+		preferences.get(Pref::OutputFormatFlacLevel).set(5);
+		didSomething = true;
+	}
+
+	i = preferences.get(Pref::OutputFormatOpusBitrate).toInt();
+	if (i < 6 || i > 128) {
+		preferences.get(Pref::OutputFormatOpusBitrate).set(24);
+		didSomething = true;
+	}
+
 	i = preferences.get(Pref::OutputStereoMix).toInt();
 	if (i < 0 || i > 100) {
 		preferences.get(Pref::OutputStereoMix).set(0);
 		didSomething = true;
 	}
 
+	i = preferences.get(Pref::OutputSegmentMinutes).toInt();
+	if (i < 0 || i > 1440) {
+		preferences.get(Pref::OutputSegmentMinutes).set(0);
+		didSomething = true;
+	}
+
+	i = preferences.get(Pref::OutputSegmentSize).toInt();
+	if (i < 0 || i > 65536) {
+		preferences.get(Pref::OutputSegmentSize).set(0);
+		didSomething = true;
+	}
+
+	i = preferences.get(Pref::OutputOggIndex).toInt();
+	if (i < 0 || i > 3600) {
+		preferences.get(Pref::OutputOggIndex).set(0);
+		didSomething = true;
+	}
+
+	i = preferences.get(Pref::OutputWavHeaderInterval).toInt();
+	if (i < 0 || i > 3600) {
+		preferences.get(Pref::OutputWavHeaderInterval).set(1);
+		didSomething = true;
+	}
+
+	s = preferences.get(Pref::OutputDurability).toString();
+	if (s != "none" && s != "periodic" && s != "header") {
+		preferences.get(Pref::OutputDurability).set("none");
+		didSomething = true;
+	}
+
+	i = preferences.get(Pref::OutputDurabilityInterval).toInt();
+	if (i < 1 || i > 3600) {
+		preferences.get(Pref::OutputDurabilityInterval).set(10);
+		didSomething = true;
+	}
+
+	i = preferences.get(Pref::OutputBufferSize).toInt();
+	if (i < 4 || i > 65536) {
+		preferences.get(Pref::OutputBufferSize).set(256);
+		didSomething = true;
+	}
+
+	i = preferences.get(Pref::OutputBufferFlushInterval).toInt();
+	if (i < 0 || i > 3600) {
+		preferences.get(Pref::OutputBufferFlushInterval).set(5);
+		didSomething = true;
+	}
+
+	s = preferences.get(Pref::OutputIoBackend).toString();
+	if (s != "auto" && s != "uring" && s != "threads" && s != "sync") {
+		preferences.get(Pref::OutputIoBackend).set("auto");
+		didSomething = true;
+	}
+
+	i = preferences.get(Pref::OutputIoInFlight).toInt();
+	if (i < 1 || i > 64) {
+		preferences.get(Pref::OutputIoInFlight).set(4);
+		didSomething = true;
+	}
+
+	i = preferences.get(Pref::OutputBatchMin).toInt();
+	if (i < 10 || i > 10000) {
+		preferences.get(Pref::OutputBatchMin).set(20);
+		didSomething = true;
+	}
+
+	// the defaults may not fit the other limits, so they are clamped to
+	// them.  otherwise these would be reset again on every start
+	int batchMin = preferences.get(Pref::OutputBatchMin).toInt();
+
+	i = preferences.get(Pref::OutputBatchMax).toInt();
+	if (i < batchMin || i > 10000) {
+		preferences.get(Pref::OutputBatchMax).set(qMax(batchMin, 2000));
+		didSomething = true;
+	}
+
+	int batchMax = preferences.get(Pref::OutputBatchMax).toInt();
+
+	i = preferences.get(Pref::OutputBatchLatency).toInt();
+	if (i < batchMin || i > batchMax) {
+		preferences.get(Pref::OutputBatchLatency).set(qBound(batchMin, 100, batchMax));
+		didSomething = true;
+	}
+
 	s = preferences.get(Pref::OutputPath).toString();
 	if (s.trimmed().isEmpty()) {
 		preferences.get(Pref::OutputPath).set("~/Skype Calls");
@@ -0,0 +1,135 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+#include <QString>
+#include <cstring>
+
+#include "ringbuffer.h"
+#include "common.h"
+
+RingBuffer::RingBuffer() :
+	data(NULL),
+	mask(-1),
+	readPos(0),
+	used(0)
+{
+}
+
+RingBuffer::~RingBuffer() {
+	delete[] data;
+}
+
+void RingBuffer::reserve(long bytes) {
+	if (bytes <= capacity())
+		return;
+
+	long newCapacity = 1;
+	while (newCapacity < bytes)
+		newCapacity <<= 1;
+
+	char *newData = new char[newCapacity];
+
+	// linearize the existing content at the beginning of the new storage
+	long first = readSize();
+	if (first)
+		std::memcpy(newData, data + readPos, first);
+	if (used > first)
+		std::memcpy(newData + first, data, used - first);
+
+	delete[] data;
+	data = newData;
+	mask = newCapacity - 1;
+	readPos = 0;
+}
+
+void RingBuffer::clear() {
+	readPos = 0;
+	used = 0;
+}
+
+long RingBuffer::readSize() const {
+	long toEnd = capacity() - readPos;
+	return used < toEnd ? used : toEnd;
+}
+
+long RingBuffer::writeSize() const {
+	long writePos = (readPos + used) & mask;
+	long toEnd = capacity() - writePos;
+	long free = space();
+	return free < toEnd ? free : toEnd;
+}
+
+void RingBuffer::commit(long bytes) {
+	used += bytes;
+}
+
+void RingBuffer::makeRoom() {
+	if (!space())
+		grow(capacity() ? capacity() : 1);
+}
+
+void RingBuffer::grow(long bytes) {
+	debug(QString("WARNING: RingBuffer overflow, growing from %1 bytes").arg(capacity()));
+	reserve(used + bytes);
+}
+
+void RingBuffer::append(const char *src, long bytes) {
+	if (bytes > space())
+		grow(bytes);
+
+	long writePos = (readPos + used) & mask;
+	long toEnd = capacity() - writePos;
+	long first = bytes < toEnd ? bytes : toEnd;
+
+	std::memcpy(data + writePos, src, first);
+	if (bytes > first)
+		std::memcpy(data, src + first, bytes - first);
+
+	used += bytes;
+}
+
+void RingBuffer::appendSilence(long bytes) {
+	if (bytes > space())
+		grow(bytes);
+
+	long writePos = (readPos + used) & mask;
+	long toEnd = capacity() - writePos;
+	long first = bytes < toEnd ? bytes : toEnd;
+
+	std::memset(data + writePos, 0, first);
+	if (bytes > first)
+		std::memset(data, 0, bytes - first);
+
+	used += bytes;
+}
+
+void RingBuffer::consume(long bytes) {
+	if (bytes > used)
+		bytes = used;
+	readPos = (readPos + bytes) & mask;
+	used -= bytes;
+
+	// when drained, start over at the beginning to keep reads contiguous
+	if (!used)
+		readPos = 0;
+}
@@ -0,0 +1,86 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <QtGlobal>
+
+#include "common.h"
+
+// A byte oriented circular buffer.  the capacity is always a power of two, so
+// that positions can be wrapped with a simple mask.  the buffer is meant to be
+// sized once up front; it only grows if data would otherwise be lost, which
+// should not happen in practice.
+
+class RingBuffer {
+public:
+	RingBuffer();
+	~RingBuffer();
+
+	void reserve(long);
+	void clear();
+
+	long size() const { return used; }
+	long capacity() const { return mask + 1; }
+	long space() const { return capacity() - used; }
+	bool isEmpty() const { return used == 0; }
+
+	void append(const char *, long);
+	void appendSilence(long);
+
+	// readPointer() points to the oldest byte in the buffer.  only
+	// readSize() bytes are contiguous from there on, the rest wraps
+	// around to the beginning of the storage
+	char *readPointer() { return data + readPos; }
+	long readSize() const;
+	void consume(long);
+
+	// the i-th 16 bit sample from the read position, for buffers holding
+	// samples.  since the read position is always at a sample boundary and
+	// the capacity is a power of two, a sample never wraps around
+	qint16 sampleAt(long i) const { return *reinterpret_cast<const qint16 *>(data + ((readPos + i * 2) & mask)); }
+
+	// the same for writing data directly into the buffer.  writePointer()
+	// points to writeSize() bytes of contiguous free space.  after filling
+	// some of it, commit() adds that many bytes to the buffer.  makeRoom()
+	// grows the buffer if it is full
+	char *writePointer() { return data + ((readPos + used) & mask); }
+	long writeSize() const;
+	void commit(long);
+	void makeRoom();
+
+private:
+	void grow(long);
+
+private:
+	char *data;
+	long mask;
+	long readPos;
+	long used;
+
+	DISABLE_COPY_AND_ASSIGNMENT(RingBuffer);
+};
+
+#endif
+
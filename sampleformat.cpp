@@ -0,0 +1,288 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+#include <cmath>
+#include <cstring>
+
+#include "sampleformat.h"
+#include "cpu.h"
+
+namespace {
+
+// portable versions
+
+void interleaveScalar(qint16 *output, const qint16 *left, const qint16 *right, long samples) {
+	for (long i = 0; i < samples; i++) {
+		output[i * 2] = left[i];
+		output[i * 2 + 1] = right[i];
+	}
+}
+
+void deinterleaveScalar(qint16 *left, qint16 *right, const qint16 *input, long samples) {
+	for (long i = 0; i < samples; i++) {
+		left[i] = input[i * 2];
+		right[i] = input[i * 2 + 1];
+	}
+}
+
+void s16ToFloatScalar(float *output, const qint16 *input, long samples) {
+	for (long i = 0; i < samples; i++)
+		output[i] = (float)input[i] * (1.0f / 32768.0f);
+}
+
+// the comparisons are written the way maxps and minps work, so that NaN
+// ends up the same as in the vector versions
+
+inline qint16 floatToS16Sample(float f) {
+	f *= 32768.0f;
+	f = f > -32768.0f ? f : -32768.0f;
+	f = f < 32767.0f ? f : 32767.0f;
+	return (qint16)lrintf(f);
+}
+
+void floatToS16Scalar(qint16 *output, const float *input, long samples) {
+	for (long i = 0; i < samples; i++)
+		output[i] = floatToS16Sample(input[i]);
+}
+
+#ifdef HAVE_X86_SIMD
+
+__attribute__((target("sse2")))
+void interleaveSSE2(qint16 *output, const qint16 *left, const qint16 *right, long samples) {
+	long i = 0;
+
+	for (; i + 8 <= samples; i += 8) {
+		__m128i l = _mm_loadu_si128((const __m128i *)(left + i));
+		__m128i r = _mm_loadu_si128((const __m128i *)(right + i));
+		_mm_storeu_si128((__m128i *)(output + i * 2), _mm_unpacklo_epi16(l, r));
+		_mm_storeu_si128((__m128i *)(output + i * 2 + 8), _mm_unpackhi_epi16(l, r));
+	}
+
+	interleaveScalar(output + i * 2, left + i, right + i, samples - i);
+}
+
+// the even (left) samples are sign extended to 32 bit with a shift pair, the
+// odd (right) ones with a single shift.  packing them back to 16 bit cannot
+// saturate
+
+__attribute__((target("sse2")))
+void deinterleaveSSE2(qint16 *left, qint16 *right, const qint16 *input, long samples) {
+	long i = 0;
+
+	for (; i + 8 <= samples; i += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(input + i * 2));
+		__m128i b = _mm_loadu_si128((const __m128i *)(input + i * 2 + 8));
+		__m128i la = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+		__m128i lb = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+		_mm_storeu_si128((__m128i *)(left + i), _mm_packs_epi32(la, lb));
+		_mm_storeu_si128((__m128i *)(right + i), _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16)));
+	}
+
+	deinterleaveScalar(left + i, right + i, input + i * 2, samples - i);
+}
+
+__attribute__((target("sse2")))
+void s16ToFloatSSE2(float *output, const qint16 *input, long samples) {
+	const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+	long i = 0;
+
+	for (; i + 8 <= samples; i += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(input + i));
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+		_mm_storeu_ps(output + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+		_mm_storeu_ps(output + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+	}
+
+	s16ToFloatScalar(output + i, input + i, samples - i);
+}
+
+// cvtps2dq rounds to nearest like lrintf() does, as long as nobody changes
+// the rounding mode
+
+__attribute__((target("sse2")))
+void floatToS16SSE2(qint16 *output, const float *input, long samples) {
+	const __m128 scale = _mm_set1_ps(32768.0f);
+	const __m128 minimum = _mm_set1_ps(-32768.0f);
+	const __m128 maximum = _mm_set1_ps(32767.0f);
+	long i = 0;
+
+	for (; i + 8 <= samples; i += 8) {
+		__m128 a = _mm_mul_ps(_mm_loadu_ps(input + i), scale);
+		__m128 b = _mm_mul_ps(_mm_loadu_ps(input + i + 4), scale);
+		a = _mm_min_ps(_mm_max_ps(a, minimum), maximum);
+		b = _mm_min_ps(_mm_max_ps(b, minimum), maximum);
+		_mm_storeu_si128((__m128i *)(output + i), _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+	}
+
+	floatToS16Scalar(output + i, input + i, samples - i);
+}
+
+// AVX2 versions.  unpack and pack instructions work within 128 bit lanes,
+// which the permutes put back into order
+
+__attribute__((target("avx2")))
+void interleaveAVX2(qint16 *output, const qint16 *left, const qint16 *right, long samples) {
+	long i = 0;
+
+	for (; i + 16 <= samples; i += 16) {
+		__m256i l = _mm256_loadu_si256((const __m256i *)(left + i));
+		__m256i r = _mm256_loadu_si256((const __m256i *)(right + i));
+		__m256i lo = _mm256_unpacklo_epi16(l, r);
+		__m256i hi = _mm256_unpackhi_epi16(l, r);
+		_mm256_storeu_si256((__m256i *)(output + i * 2), _mm256_permute2x128_si256(lo, hi, 0x20));
+		_mm256_storeu_si256((__m256i *)(output + i * 2 + 16), _mm256_permute2x128_si256(lo, hi, 0x31));
+	}
+
+	interleaveScalar(output + i * 2, left + i, right + i, samples - i);
+}
+
+__attribute__((target("avx2")))
+void deinterleaveAVX2(qint16 *left, qint16 *right, const qint16 *input, long samples) {
+	long i = 0;
+
+	for (; i + 16 <= samples; i += 16) {
+		__m256i a = _mm256_loadu_si256((const __m256i *)(input + i * 2));
+		__m256i b = _mm256_loadu_si256((const __m256i *)(input + i * 2 + 16));
+		__m256i la = _mm256_srai_epi32(_mm256_slli_epi32(a, 16), 16);
+		__m256i lb = _mm256_srai_epi32(_mm256_slli_epi32(b, 16), 16);
+		__m256i l = _mm256_packs_epi32(la, lb);
+		__m256i r = _mm256_packs_epi32(_mm256_srai_epi32(a, 16), _mm256_srai_epi32(b, 16));
+		_mm256_storeu_si256((__m256i *)(left + i), _mm256_permute4x64_epi64(l, 0xd8));
+		_mm256_storeu_si256((__m256i *)(right + i), _mm256_permute4x64_epi64(r, 0xd8));
+	}
+
+	deinterleaveScalar(left + i, right + i, input + i * 2, samples - i);
+}
+
+__attribute__((target("avx2")))
+void s16ToFloatAVX2(float *output, const qint16 *input, long samples) {
+	const __m256 scale = _mm256_set1_ps(1.0f / 32768.0f);
+	long i = 0;
+
+	for (; i + 8 <= samples; i += 8) {
+		__m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(input + i)));
+		_mm256_storeu_ps(output + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+	}
+
+	s16ToFloatScalar(output + i, input + i, samples - i);
+}
+
+__attribute__((target("avx2")))
+void floatToS16AVX2(qint16 *output, const float *input, long samples) {
+	const __m256 scale = _mm256_set1_ps(32768.0f);
+	const __m256 minimum = _mm256_set1_ps(-32768.0f);
+	const __m256 maximum = _mm256_set1_ps(32767.0f);
+	long i = 0;
+
+	for (; i + 16 <= samples; i += 16) {
+		__m256 a = _mm256_mul_ps(_mm256_loadu_ps(input + i), scale);
+		__m256 b = _mm256_mul_ps(_mm256_loadu_ps(input + i + 8), scale);
+		a = _mm256_min_ps(_mm256_max_ps(a, minimum), maximum);
+		b = _mm256_min_ps(_mm256_max_ps(b, minimum), maximum);
+		__m256i v = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+		_mm256_storeu_si256((__m256i *)(output + i), _mm256_permute4x64_epi64(v, 0xd8));
+	}
+
+	floatToS16Scalar(output + i, input + i, samples - i);
+}
+
+#endif
+
+// run time selection, see mixer.cpp
+
+struct Kernels {
+	void (*interleave)(qint16 *, const qint16 *, const qint16 *, long);
+	void (*deinterleave)(qint16 *, qint16 *, const qint16 *, long);
+	void (*s16ToFloat)(float *, const qint16 *, long);
+	void (*floatToS16)(qint16 *, const float *, long);
+	const char *name;
+};
+
+const Kernels scalarKernels = { interleaveScalar, deinterleaveScalar, s16ToFloatScalar, floatToS16Scalar, "scalar" };
+#ifdef HAVE_X86_SIMD
+const Kernels sse2Kernels = { interleaveSSE2, deinterleaveSSE2, s16ToFloatSSE2, floatToS16SSE2, "SSE2" };
+const Kernels avx2Kernels = { interleaveAVX2, deinterleaveAVX2, s16ToFloatAVX2, floatToS16AVX2, "AVX2" };
+#endif
+
+const Kernels *selectKernels() {
+#ifdef HAVE_X86_SIMD
+	if (cpuHasAVX2())
+		return &avx2Kernels;
+	if (cpuHasSSE2())
+		return &sse2Kernels;
+#endif
+	return &scalarKernels;
+}
+
+const Kernels *findKernels(const char *name) {
+	if (std::strcmp(name, scalarKernels.name) == 0)
+		return &scalarKernels;
+#ifdef HAVE_X86_SIMD
+	if (std::strcmp(name, sse2Kernels.name) == 0 && cpuHasSSE2())
+		return &sse2Kernels;
+	if (std::strcmp(name, avx2Kernels.name) == 0 && cpuHasAVX2())
+		return &avx2Kernels;
+#endif
+	return NULL;
+}
+
+// the writers run on the encoder threads, but they would all select the same
+const Kernels *kernels = NULL;
+
+inline const Kernels *getKernels() {
+	if (!kernels)
+		kernels = selectKernels();
+	return kernels;
+}
+
+}
+
+void interleave(qint16 *output, const qint16 *left, const qint16 *right, long samples) {
+	getKernels()->interleave(output, left, right, samples);
+}
+
+void deinterleave(qint16 *left, qint16 *right, const qint16 *input, long samples) {
+	getKernels()->deinterleave(left, right, input, samples);
+}
+
+void s16ToFloat(float *output, const qint16 *input, long samples) {
+	getKernels()->s16ToFloat(output, input, samples);
+}
+
+void floatToS16(qint16 *output, const float *input, long samples) {
+	getKernels()->floatToS16(output, input, samples);
+}
+
+const char *sampleFormatImplementation() {
+	return getKernels()->name;
+}
+
+bool setSampleFormatImplementation(const char *name) {
+	const Kernels *k = findKernels(name);
+	if (!k)
+		return false;
+	kernels = k;
+	return true;
+}
+
@@ -0,0 +1,49 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+#ifndef SAMPLEFORMAT_H
+#define SAMPLEFORMAT_H
+
+#include <QtGlobal>
+
+// Sample format conversions shared by the writers.  like the mixer, these
+// have SSE2 and AVX2 versions selected at run time, which give exactly the
+// same results as the portable ones.  none of the pointers need to be aligned
+
+// left/right -> LRLR...
+void interleave(qint16 *, const qint16 *, const qint16 *, long);
+// LRLR... -> left/right
+void deinterleave(qint16 *, qint16 *, const qint16 *, long);
+
+// 16 bit integer to float in [-1.0, 1.0), i.e. divided by 32768
+void s16ToFloat(float *, const qint16 *, long);
+// and back, rounded to the nearest integer and clipped.  NaN becomes -32768
+void floatToS16(qint16 *, const float *, long);
+
+// name of the version in use, "scalar", "SSE2" or "AVX2"
+const char *sampleFormatImplementation();
+// forces a version, for the tests.  fails if the CPU can't run it
+bool setSampleFormatImplementation(const char *);
+
+#endif
+
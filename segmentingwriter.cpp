@@ -0,0 +1,215 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+#include <climits>
+
+#include "segmentingwriter.h"
+#include "common.h"
+#include "preferences.h"
+#include "filename.h"
+
+SegmentingWriter::SegmentingWriter(const QString &f, long seconds, qint64 bytes) :
+	format(f),
+	maxSeconds(seconds),
+	maxBytes(bytes),
+	maxSamples(0),
+	writer(NULL),
+	segment(0),
+	segmentSamples(0),
+	finishedBytes(0),
+	finishedSamples(0),
+	haveTags(false),
+	isOpen(false)
+{
+	settings.copyFrom(preferences);
+}
+
+SegmentingWriter::~SegmentingWriter() {
+	if (isOpen) {
+		debug("WARNING: SegmentingWriter::~SegmentingWriter(): File has not been closed, closing it now");
+		close();
+	}
+}
+
+void SegmentingWriter::setPreferences(BasePreferences *p) {
+	settings.copyFrom(*p);
+}
+
+void SegmentingWriter::setTags(const QString &comment, const QDateTime &t) {
+	AudioFileWriter::setTags(comment, t);
+	haveTags = true;
+	if (writer)
+		writer->setTags(comment, t);
+}
+
+bool SegmentingWriter::open(const QString &fn, long sr, bool s) {
+	// our own file isn't used
+	pattern = fn;
+	sampleRate = sr;
+	stereo = s;
+	maxSamples = (qint64)maxSeconds * sr;
+
+	isOpen = startSegment();
+	return isOpen;
+}
+
+void SegmentingWriter::close() {
+	if (!isOpen) {
+		debug("WARNING: SegmentingWriter::close() called, but file not open");
+		return;
+	}
+
+	if (writer)
+		endSegment();
+
+	debug(QString("Wrote %1 samples in %2 segments").arg(samplesWritten).arg(segment));
+	isOpen = false;
+}
+
+bool SegmentingWriter::write(const qint16 *left, const qint16 *right, long samples, bool flush) {
+	do {
+		// the next segment is only started once there is something to
+		// write, so that no empty segment is left at the end
+		if (!writer) {
+			if (samples == 0)
+				return true;
+			if (!startSegment())
+				return false;
+		}
+
+		// the write that fills the segment also flushes it, so that
+		// closing it has nothing left to do
+		long count = samples;
+		bool full = false;
+		if (maxSamples && count >= maxSamples - segmentSamples) {
+			count = maxSamples - segmentSamples;
+			full = true;
+		}
+		if (maxBytes) {
+			long fit = samplesFitting();
+			if (count >= fit) {
+				count = fit;
+				full = true;
+			}
+		}
+
+		bool b = writer->write(left, right, count, full || (flush && count == samples));
+
+		QStringList lost = writer->takeLostFileNames();
+		for (int i = 0; i < lost.size(); i++)
+			names.removeAll(lost.at(i));
+		lostNames += lost;
+
+		if (!b)
+			return false;
+
+		segmentSamples += count;
+		samplesWritten += count;
+		samples -= count;
+		if (samples) {
+			left += count;
+			if (right)
+				right += count;
+		}
+
+		if (full)
+			endSegment();
+	} while (samples);
+
+	return true;
+}
+
+bool SegmentingWriter::startSegment() {
+	segment++;
+	segmentSamples = 0;
+
+	writer = AudioFileWriter::create(format);
+	writer->setPreferences(&settings);
+	if (haveTags)
+		writer->setTags(tagComment, tagTime);
+
+	bool b = writer->open(getSegmentFileName(pattern, segment), sampleRate, stereo);
+	names += writer->fileNames();
+
+	if (!b) {
+		debug(QString("WARNING: could not open segment %1 '%2'").arg(segment).arg(writer->fileName()));
+		delete writer;
+		writer = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+void SegmentingWriter::endSegment() {
+	writer->close();
+	finishedBytes += writer->size();
+	finishedSamples += segmentSamples;
+	delete writer;
+	writer = NULL;
+}
+
+long SegmentingWriter::samplesFitting() const {
+	// a segment gets at least one sample, otherwise it would never end
+	long least = segmentSamples ? 0 : 1;
+
+	qint64 room = maxBytes - writer->size();
+	if (room <= 0)
+		return least;
+
+	// the finished segments include everything the encoder held back
+	// until flushing, so they give the better estimate.  the first
+	// segment can only go by itself
+	qint64 bytes = finishedBytes;
+	qint64 samples = finishedSamples;
+	if (!samples) {
+		bytes = writer->size();
+		samples = segmentSamples;
+	}
+	if (!samples || !bytes)
+		return LONG_MAX;
+
+	double fit = (double)room * samples / bytes;
+	if (fit >= LONG_MAX)
+		return LONG_MAX;
+	return qMax(least, (long)fit);
+}
+
+QString SegmentingWriter::fileName() const {
+	return names.isEmpty() ? QString() : names.first();
+}
+
+QStringList SegmentingWriter::fileNames() const {
+	return names;
+}
+
+QStringList SegmentingWriter::takeLostFileNames() {
+	QStringList list = lostNames;
+	lostNames.clear();
+	return list;
+}
+
+qint64 SegmentingWriter::size() const {
+	return writer ? writer->size() : 0;
+}
+
@@ -0,0 +1,93 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+#ifndef SEGMENTINGWRITER_H
+#define SEGMENTINGWRITER_H
+
+#include <QString>
+#include <QStringList>
+
+#include "common.h"
+#include "preferences.h"
+#include "writer.h"
+
+// splits a recording into several files, each one written by a writer of
+// its own.  the file name given to open() is a pattern from getFileName()
+// with a negative segment, which getSegmentFileName() turns into the name
+// of each segment.  a segment is closed as soon as it is full, so it can
+// be processed while the next one is being written.  since the segments are
+// opened by an encoder thread, they use a copy of the preferences taken when
+// this writer is created
+
+class SegmentingWriter : public AudioFileWriter {
+public:
+	// the limits are per segment, 0 meaning no limit.  the time limit
+	// splits at the exact sample.  the size limit splits where the
+	// segment is estimated to reach it, from the bytes per sample so far,
+	// so a segment may still end up slightly bigger
+	SegmentingWriter(const QString &, long, qint64);
+	virtual ~SegmentingWriter();
+
+	virtual void setPreferences(BasePreferences *);
+
+	virtual void setTags(const QString &, const QDateTime &);
+	virtual bool open(const QString &, long, bool);
+	virtual void close();
+	virtual bool write(const qint16 *, const qint16 *, long, bool = false);
+
+	virtual QString fileName() const;
+	virtual QStringList fileNames() const;
+	virtual QStringList takeLostFileNames();
+	virtual qint64 size() const;
+
+private:
+	bool startSegment();
+	void endSegment();
+	long samplesFitting() const;
+
+private:
+	QString format;
+	long maxSeconds;
+	qint64 maxBytes;
+	qint64 maxSamples;
+	QString pattern;
+	BasePreferences settings;
+	// NULL between segments
+	AudioFileWriter *writer;
+	int segment;
+	qint64 segmentSamples;
+	// totals of the finished segments, for estimating their bytes per
+	// sample
+	qint64 finishedBytes;
+	qint64 finishedSamples;
+	bool haveTags;
+	bool isOpen;
+	QStringList names;
+	// taken from the writer of the segment before it is deleted
+	QStringList lostNames;
+
+	DISABLE_COPY_AND_ASSIGNMENT(SegmentingWriter);
+};
+
+#endif
+
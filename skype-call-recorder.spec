@@ -9,15 +9,17 @@ Group:          Applications/Internet
 Source0:        %{name}-%{version}.tar.bz2
 
 BuildRequires:  lame-devel
-BuildRequires:  id3lib-devel
 BuildRequires:  libvorbis-devel
+BuildRequires:  opus-devel
+BuildRequires:  flac-devel
 
 Requires:  lame
-Requires:  id3lib
 Requires:  libvorbis
+Requires:  opus
+Requires:  flac
 
 %description
-Skype Call recorder allows you to record Skype calls to MP3, Ogg Vorbis or WAV files.
+Skype Call recorder allows you to record Skype calls to MP3, Ogg Vorbis, Opus, FLAC or WAV files.
 
 %prep
 %setup -q -n %{name}
@@ -111,24 +111,22 @@ void SkypeDBus::sendWithAsyncReply(const QString &s) {
 	dbus.callWithCallback(msg, this, SLOT(methodCallback(const QDBusMessage &)), SLOT(methodError(const QDBusError &, const QDBusMessage &)), 3600000);
 }
 
-QString SkypeDBus::sendWithReply(const QString &s, int timeout) {
-	debug(QString("SKYPE --> %1 (sync reply)").arg(s));
+SkypeReply *SkypeDBus::sendForReply(const QString &s, int timeout, const QString &prefix) {
+	debug(QString("SKYPE --> %1 (pipelined reply)").arg(s));
 
 	QDBusMessage msg = QDBusMessage::createMethodCall(skypeServiceName, "/com/Skype", skypeInterfaceName, "Invoke");
 	QList<QVariant> args;
 	args.append(s);
 	msg.setArguments(args);
 
-	msg = dbus.call(msg, QDBus::Block, timeout);
-
-	if (msg.type() != QDBusMessage::ReplyMessage) {
-		debug(QString("SKYPE <R- (failed)"));
-		return QString();
+	SkypeDBusReply *reply = new SkypeDBusReply(this, prefix);
+	if (!dbus.callWithCallback(msg, reply, SLOT(methodCallback(const QDBusMessage &)),
+			SLOT(methodError(const QDBusError &, const QDBusMessage &)), timeout)) {
+		// the reply still arrives asynchronously, like for any
+		// other failure
+		QTimer::singleShot(0, reply, SLOT(methodFailed()));
 	}
-
-	QString ret = msg.arguments().value(0).toString();
-	debug(QString("SKYPE <R- %1").arg(ret));
-	return ret;
+	return reply;
 }
 
 void SkypeDBus::send(const QString &s) {
@@ -187,14 +185,45 @@ void SkypeDBus::poll() {
 	if (connectionState == 0) {
 		connectToSkype();
 	} else if (connectionState == 3) {
-		if (sendWithReply("PING", 2000) != "PONG") {
-			debug("Skype didn't reply with PONG to our PING");
-			connectionState = 0;
-			emit connected(false);
-		}
+		SkypeReply *reply = sendAsync("PING", 2000);
+		connect(reply, SIGNAL(finished(const QString &)), this, SLOT(pingReply(const QString &)));
 	}
 }
 
+void SkypeDBus::pingReply(const QString &s) {
+	// the connection may have changed while waiting
+	if (connectionState != 3)
+		return;
+
+	if (s != "PONG") {
+		debug("Skype didn't reply with PONG to our PING");
+		connectionState = 0;
+		emit connected(false);
+	}
+}
+
+// ---- SkypeDBusReply ----
+
+void SkypeDBusReply::methodCallback(const QDBusMessage &msg) {
+	if (msg.type() != QDBusMessage::ReplyMessage) {
+		methodFailed();
+		return;
+	}
+
+	QString s = msg.arguments().value(0).toString();
+	debug(QString("SKYPE <R- %1").arg(s));
+	finish(s);
+}
+
+void SkypeDBusReply::methodError(const QDBusError &, const QDBusMessage &) {
+	methodFailed();
+}
+
+void SkypeDBusReply::methodFailed() {
+	debug(QString("SKYPE <R- (failed)"));
+	finish(QString());
+}
+
 // ---- SkypeExport ----
 
 SkypeExport::SkypeExport(SkypeDBus *p) : QDBusAbstractAdaptor(p), parent(p) {
@@ -43,7 +43,6 @@ public:
 	friend class SkypeExport;
 
 	SkypeDBus(QObject *);
-	virtual QString sendWithReply(const QString &, int = 10000);
 	virtual void send(const QString &);
 
 protected slots:
@@ -52,8 +51,10 @@ protected slots:
 	void methodError(const QDBusError &, const QDBusMessage &);
 	void serviceOwnerChanged(const QString &, const QString &, const QString &);
 	void poll();
+	void pingReply(const QString &);
 
 protected:
+	virtual SkypeReply *sendForReply(const QString &, int, const QString &);
 	virtual void sendWithAsyncReply(const QString &);
 
 protected:
@@ -64,6 +65,22 @@ protected:
 	DISABLE_COPY_AND_ASSIGNMENT(SkypeDBus);
 };
 
+// receives the DBus reply to one command
+
+class SkypeDBusReply : public SkypeReply {
+	Q_OBJECT
+public:
+	SkypeDBusReply(QObject *parent, const QString &prefix) : SkypeReply(parent, prefix) { }
+
+public slots:
+	void methodCallback(const QDBusMessage &);
+	void methodError(const QDBusError &, const QDBusMessage &);
+	void methodFailed();
+
+private:
+	DISABLE_COPY_AND_ASSIGNMENT(SkypeDBusReply);
+};
+
 class SkypeExport : public QDBusAbstractAdaptor {
 	Q_OBJECT
 	Q_CLASSINFO("D-Bus Interface", "com.Skype.API.Client")
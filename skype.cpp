@@ -32,11 +32,12 @@
 Skype::Skype(QObject *parent) : QObject(parent), connectionState(0) {
 }
 
-QString Skype::getObject(const QString &object) {
-	QString ret = sendWithReply("GET " + object);
-	if (!ret.startsWith(object))
-		return QString();
-	return ret.mid(object.size() + 1);
+SkypeReply *Skype::sendAsync(const QString &s, int timeout) {
+	return sendForReply(s, timeout, QString());
+}
+
+SkypeReply *Skype::getObjectAsync(const QString &object) {
+	return sendForReply("GET " + object, 10000, object);
 }
 
 void Skype::doNotify(const QString &s) {
@@ -51,3 +52,19 @@ void Skype::doNotify(const QString &s) {
 	emit notify(s);
 }
 
+// ---- SkypeReply ----
+
+SkypeReply::SkypeReply(QObject *parent, const QString &p) : QObject(parent), prefix(p) {
+}
+
+void SkypeReply::finish(const QString &reply) {
+	if (prefix.isEmpty())
+		emit finished(reply);
+	else if (!reply.startsWith(prefix))
+		emit finished(QString());
+	else
+		emit finished(reply.mid(prefix.size() + 1));
+
+	deleteLater();
+}
+
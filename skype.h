@@ -29,13 +29,41 @@
 
 #include "common.h"
 
+// the reply to a command sent with Skype::sendAsync().  it emits finished()
+// once, with an empty string if the command failed or timed out, and then
+// deletes itself.  any number of replies may be pending at once, so several
+// commands only cost a single round trip
+
+class SkypeReply : public QObject {
+	Q_OBJECT
+public:
+	SkypeReply(QObject *, const QString & = QString());
+
+signals:
+	void finished(const QString &);
+
+protected:
+	void finish(const QString &);
+
+private:
+	// for GET commands, the object name the reply starts with.  it is
+	// removed from the reply, like getObjectAsync() promises
+	QString prefix;
+
+	DISABLE_COPY_AND_ASSIGNMENT(SkypeReply);
+};
+
 class Skype : public QObject {
 	Q_OBJECT
 public:
 	Skype(QObject *);
-	virtual QString sendWithReply(const QString &, int = 10000) = 0;
+	// sends a command without waiting for the reply.  connect to the
+	// finished() signal of the returned object to get it
+	SkypeReply *sendAsync(const QString &, int = 10000);
 	virtual void send(const QString &) = 0;
-	QString getObject(const QString &);
+	// like sendAsync() with "GET <object>", but the reply only holds the
+	// value of the object
+	SkypeReply *getObjectAsync(const QString &);
 	const QString &getSkypeName() const { return skypeName; }
 
 signals:
@@ -44,6 +72,8 @@ signals:
 	void connectionFailed(const QString &) const;
 
 protected:
+	// sends a command, with a timeout and the prefix for the SkypeReply
+	virtual SkypeReply *sendForReply(const QString &, int, const QString &) = 0;
 	virtual void sendWithAsyncReply(const QString &) = 0;
 	void doNotify(const QString &);
 
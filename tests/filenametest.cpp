@@ -0,0 +1,96 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+// Checks how file name patterns are expanded: the replacements, that the
+// names can't add directories or strftime() directives, and that names for
+// segments built in two steps with "&n" left in are the same as those built
+// directly, whatever & characters the names and the path hold
+
+#include <QDate>
+#include <QDateTime>
+#include <QString>
+#include <QTime>
+#include <cstdio>
+
+#include "filename.h"
+
+namespace {
+int failures = 0;
+
+const QDateTime timestamp(QDate(2009, 3, 7), QTime(21, 5));
+
+void check(const char *what, const QString &name, const QString &expected) {
+	if (name != expected) {
+		std::printf("FAIL: %s: '%s' instead of '%s'\n", what, name.toUtf8().constData(),
+			expected.toUtf8().constData());
+		failures++;
+	}
+}
+
+QString expand(const QString &path, const QString &pattern, const QString &skypeName, int segment) {
+	return expandFileName(path, pattern, skypeName, "Display Name", "me", "My Name", timestamp, segment);
+}
+
+void checkPatterns() {
+	check("replacements", expand("/rec", "%Y-%m-%d %H%M &s, &d, &t, &e", "echo123", 0),
+		"/rec/2009-03-07 2105 echo123, Display Name, me, My Name");
+	check("escaped names", expand("/rec", "&s", "a/b 100%d", 0), "/rec/a_b 100%d");
+	check("ampersands", expand("/r&d", "&& &x &s &", "a&b", 0), "/r&d/& &x a&b &");
+	check("no segment", expand("/rec", "&s&n", "x", 0), "/rec/x");
+	check("segment", expand("/rec", "&s-&n", "x", 12), "/rec/x-012");
+	check("segment without &n", expand("/rec", "&s", "x", 3), "/rec/x, part 003");
+}
+
+// the pattern for segments keeps "&n", and doubles the & characters from
+// everything else, so that names holding "&n" are left alone
+void checkSegments() {
+	const char * const patterns[] = { "&s-&n &&", "&s", "&d &n" };
+	const char * const names[] = { "x", "a&b", "a&n", "&&" };
+
+	for (unsigned int i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++) {
+		for (unsigned int j = 0; j < sizeof(names) / sizeof(names[0]); j++) {
+			QString pattern = expand("/r&d", patterns[i], names[j], -1);
+			for (int segment = 1; segment <= 1000; segment *= 10)
+				check("segment pattern", getSegmentFileName(pattern, segment),
+					expand("/r&d", patterns[i], names[j], segment));
+		}
+	}
+
+	check("segment pattern", expand("/r&d", "&s-&n", "a&n", -1), "/r&&d/a&&n-&n");
+	check("segment name", getSegmentFileName("/r&&d/a&&n-&n", 2), "/r&d/a&n-002");
+}
+}
+
+int main() {
+	checkPatterns();
+	checkSegments();
+
+	if (failures) {
+		std::printf("%d failures\n", failures);
+		return 1;
+	}
+
+	std::printf("checked\n");
+	return 0;
+}
+
@@ -0,0 +1,182 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+// Checks the ID3v2.3 tag written at the start of MP3 files: the syncsafe
+// size in its header, the frames it holds, and that it keeps its fixed size
+// whatever the comment is
+
+#include <QByteArray>
+#include <QDate>
+#include <QDateTime>
+#include <QString>
+#include <QTime>
+#include <cstdio>
+#include <cstring>
+
+#include "id3tag.h"
+
+namespace {
+int failures = 0;
+const char *what = "";
+
+void fail(const char *message) {
+	std::printf("FAIL: %s: %s\n", what, message);
+	failures++;
+}
+
+quint32 getUInt32BE(const QByteArray &array, int offset) {
+	quint32 i = 0;
+	for (int j = 0; j < 4; j++)
+		i = (i << 8) | (unsigned char)array.at(offset + j);
+	return i;
+}
+
+quint32 getSyncsafe(const QByteArray &array, int offset) {
+	quint32 i = 0;
+	for (int j = 0; j < 4; j++)
+		i = (i << 7) | (array.at(offset + j) & 0x7f);
+	return i;
+}
+
+void checkSyncsafe(quint32 i, const char *expected) {
+	what = "syncsafe";
+	QByteArray array;
+	appendSyncsafe(array, i);
+	if (array.size() != 4 || std::memcmp(array.constData(), expected, 4) != 0) {
+		std::printf("FAIL: %s: wrong encoding of %u\n", what, i);
+		failures++;
+	}
+	for (int j = 0; j < array.size(); j++)
+		if (array.at(j) & 0x80)
+			fail("high bit set");
+	if (getSyncsafe(array, 0) != i)
+		fail("does not decode to the same value");
+}
+
+// returns the body of the given frame, or a null array if the tag doesn't
+// have it.  walks the frames up to the padding
+QByteArray findFrame(const QByteArray &tag, const char *id) {
+	int offset = 10;
+	while (offset + 10 <= tag.size() && tag.at(offset) != 0) {
+		int size = getUInt32BE(tag, offset + 4);
+		if (offset + 10 + size > tag.size()) {
+			fail("frame past the end of the tag");
+			break;
+		}
+		if (tag.mid(offset, 4) == id)
+			return tag.mid(offset + 10, size);
+		offset += 10 + size;
+	}
+	return QByteArray();
+}
+
+void checkHeader(const QByteArray &tag) {
+	if (tag.size() != id3TagSize) {
+		fail("wrong tag size");
+		return;
+	}
+	if (!tag.startsWith("ID3") || tag.at(3) != 3 || tag.at(4) != 0 || tag.at(5) != 0)
+		fail("wrong tag header");
+	if ((int)getSyncsafe(tag, 6) != id3TagSize - 10)
+		fail("wrong size in the tag header");
+}
+
+void checkFrame(const QByteArray &tag, const char *id, const QByteArray &body) {
+	if (findFrame(tag, id) != body) {
+		std::printf("FAIL: %s: wrong or missing frame %s\n", what, id);
+		failures++;
+	}
+}
+
+// the body of a text frame in ISO-8859-1
+QByteArray latin1Text(const char *text) {
+	QByteArray body(1, 0);
+	body.append(text);
+	return body;
+}
+
+void checkTag() {
+	what = "tag";
+	QDateTime time(QDate(2009, 3, 7), QTime(21, 5));
+	QByteArray tag = buildId3Tag(time, "Call with someone");
+	checkHeader(tag);
+
+	// text frames are encoded as ISO-8859-1, with the date as DDMM and
+	// the time as HHMM
+	checkFrame(tag, "TCON", latin1Text("(101)Skype Call"));
+	checkFrame(tag, "TYER", latin1Text("2009"));
+	checkFrame(tag, "TDAT", latin1Text("0703"));
+	checkFrame(tag, "TIME", latin1Text("2105"));
+	QByteArray comment = latin1Text("eng");
+	comment.append('\0');
+	comment.append("Call with someone");
+	checkFrame(tag, "COMM", comment);
+}
+
+void checkUnicodeComment() {
+	what = "unicode comment";
+	QString comment;
+	comment.append(QChar(0x263a));
+	QByteArray tag = buildId3Tag(QDateTime(QDate(2009, 3, 7), QTime(21, 5)), comment);
+	checkHeader(tag);
+
+	// UTF-16 with BOM and a two byte terminator for the description
+	QByteArray body(1, 1);
+	body.append("eng\xff\xfe");
+	body.append(QByteArray(2, 0));
+	body.append("\xff\xfe\x3a\x26");
+	checkFrame(tag, "COMM", body);
+}
+
+void checkLongComment() {
+	what = "long comment";
+	QString comment(10000, 'x');
+	QByteArray tag = buildId3Tag(QDateTime(QDate(2009, 3, 7), QTime(21, 5)), comment);
+	checkHeader(tag);
+
+	QByteArray body = findFrame(tag, "COMM");
+	if (body.size() < 1000 || body.size() >= comment.size())
+		fail("the comment was not truncated to fit");
+	checkFrame(tag, "TCON", latin1Text("(101)Skype Call"));
+}
+}
+
+int main() {
+	checkSyncsafe(0, "\x00\x00\x00\x00");
+	checkSyncsafe(0x7f, "\x00\x00\x00\x7f");
+	checkSyncsafe(0x80, "\x00\x00\x01\x00");
+	checkSyncsafe(id3TagSize - 10, "\x00\x00\x1f\x76");
+	checkSyncsafe(0x0fffffff, "\x7f\x7f\x7f\x7f");
+	checkTag();
+	checkUnicodeComment();
+	checkLongComment();
+
+	if (failures) {
+		std::printf("%d failures\n", failures);
+		return 1;
+	}
+
+	std::printf("checked\n");
+	return 0;
+}
+
@@ -0,0 +1,145 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+// Measures the mixing kernels on 100 ms blocks at the Skype sample rate,
+// comparing each vector version to the portable one and to the plain
+// division based mixing they replaced.  build it with "make mixerbench",
+// it isn't built by default
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+#include "mixer.h"
+
+namespace {
+const long samples = 1600;
+const int repetitions = 50000;
+// each measurement is the best of a few rounds, so that other load on the
+// machine matters less
+const int rounds = 5;
+
+qint16 local[samples], remote[samples], left[samples], right[samples];
+
+double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// how mixing was done before the kernels
+void oldMono(qint16 *output, const qint16 *local, const qint16 *remote, long n) {
+	for (long i = 0; i < n; i++)
+		output[i] = ((qint32)local[i] + (qint32)remote[i]) / 2;
+}
+
+void oldStereo(qint16 *outputLeft, qint16 *outputRight, const qint16 *local, const qint16 *remote, long n, int pan) {
+	qint32 fl = 100 - pan, fr = pan;
+	for (long i = 0; i < n; i++) {
+		outputLeft[i] = ((qint32)local[i] * fl + (qint32)remote[i] * fr + 50) / 100;
+		outputRight[i] = ((qint32)local[i] * fr + (qint32)remote[i] * fl + 50) / 100;
+	}
+}
+
+// keeps the compiler from dropping the loops
+inline void clobber() {
+	__asm__ volatile("" ::: "memory");
+}
+
+// the mixing functions are wrapped so that they can be inlined, like the old
+// code was
+struct OldMono {
+	void operator()() const { oldMono(left, local, remote, samples); }
+};
+
+struct OldStereo {
+	void operator()() const { oldStereo(left, right, local, remote, samples, 30); }
+};
+
+struct Mono {
+	void operator()() const { mixToMono(left, local, remote, samples); }
+};
+
+struct Stereo {
+	void operator()() const { mixToStereo(left, right, local, remote, samples, 30); }
+};
+
+template <typename Mix>
+double measure(Mix mix) {
+	double best = 0.0;
+	for (int round = 0; round < rounds; round++) {
+		double start = now();
+		for (int i = 0; i < repetitions; i++) {
+			mix();
+			clobber();
+		}
+		double seconds = now() - start;
+		if (round == 0 || seconds < best)
+			best = seconds;
+	}
+	return best;
+}
+
+void report(const char *name, double seconds, double reference) {
+	double rate = (double)repetitions * samples / seconds / 1e6;
+	std::printf("%-16s %8.0f Msamples/s  x%.1f\n", name, rate, reference / seconds);
+}
+}
+
+int main() {
+	std::srand(1);
+	for (long i = 0; i < samples; i++) {
+		local[i] = (qint16)(std::rand() & 0xffff);
+		remote[i] = (qint16)(std::rand() & 0xffff);
+	}
+
+	double oldMonoTime = measure(OldMono());
+	double oldStereoTime = measure(OldStereo());
+
+	std::printf("mono, speedup relative to the old code\n");
+	report("old", oldMonoTime, oldMonoTime);
+
+	const char *impls[] = { "scalar", "SSE2", "AVX2" };
+	double monoTimes[3], stereoTimes[3];
+	for (int k = 0; k < 3; k++) {
+		monoTimes[k] = stereoTimes[k] = 0.0;
+		if (!setMixerImplementation(impls[k]))
+			continue;
+
+		monoTimes[k] = measure(Mono());
+		stereoTimes[k] = measure(Stereo());
+	}
+
+	for (int k = 0; k < 3; k++)
+		if (monoTimes[k] > 0.0)
+			report(impls[k], monoTimes[k], oldMonoTime);
+
+	std::printf("\nstereo with 30%% mix, speedup relative to the old code\n");
+	report("old", oldStereoTime, oldStereoTime);
+	for (int k = 0; k < 3; k++)
+		if (stereoTimes[k] > 0.0)
+			report(impls[k], stereoTimes[k], oldStereoTime);
+
+	return 0;
+}
+
@@ -0,0 +1,193 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+// Feeds OggIndex the pages of made up Ogg streams and checks the file it
+// writes: the header, that entry k points to the page holding the sample at
+// k * interval, and that entries only reach the file once the pages they
+// point to have been written
+
+#include <QString>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+#include "oggindex.h"
+
+namespace {
+const int headerSize = 24;
+const int entrySize = 16;
+
+int failures = 0;
+const char *what = "";
+
+void fail(const char *message) {
+	std::printf("FAIL: %s: %s\n", what, message);
+	failures++;
+}
+
+quint64 getUInt(const unsigned char *d, int bytes) {
+	quint64 i = 0;
+	for (int j = bytes - 1; j >= 0; j--)
+		i = (i << 8) | d[j];
+	return i;
+}
+
+// reads the whole index file
+int readIndex(const char *name, unsigned char *buffer, int size) {
+	FILE *f = std::fopen(name, "rb");
+	if (!f)
+		return -1;
+	int n = std::fread(buffer, 1, size, f);
+	std::fclose(f);
+	return n;
+}
+
+// checks the header and that the file holds exactly the given entries
+void checkFile(const char *name, long rate, long preSkip, int interval,
+	const qint64 *entries, int count)
+{
+	unsigned char buffer[4096];
+	int size = readIndex(name, buffer, sizeof(buffer));
+	if (size != headerSize + count * entrySize) {
+		fail("the file has the wrong size");
+		return;
+	}
+
+	if (std::memcmp(buffer, "SCRX", 4) != 0 || getUInt(buffer + 4, 4) != 1)
+		fail("wrong magic or version");
+	if (getUInt(buffer + 8, 4) != (quint64)rate || getUInt(buffer + 12, 4) != (quint64)preSkip ||
+			getUInt(buffer + 16, 4) != (quint64)interval)
+		fail("wrong rate, pre-skip or interval");
+	if (getUInt(buffer + 20, 4) != (quint64)count)
+		fail("wrong count");
+
+	for (int i = 0; i < count; i++) {
+		const unsigned char *entry = buffer + headerSize + i * entrySize;
+		if ((qint64)getUInt(entry, 8) != entries[2 * i] || (qint64)getUInt(entry + 8, 8) != entries[2 * i + 1]) {
+			std::printf("FAIL: %s: entry %d is %lld/%lld instead of %lld/%lld\n", what, i,
+				(long long)getUInt(entry, 8), (long long)getUInt(entry + 8, 8),
+				(long long)entries[2 * i], (long long)entries[2 * i + 1]);
+			failures++;
+		}
+	}
+}
+
+// pages of 1000 bytes ending every half second, a page without a packet
+// end, and a long page crossing two entry points
+void checkStream() {
+	what = "stream";
+	char name[] = "/tmp/oggindextestXXXXXX";
+	int fd = mkstemp(name);
+	if (fd < 0) {
+		fail("could not create a temporary file");
+		return;
+	}
+	close(fd);
+
+	const long rate = 48000;
+	const long preSkip = 312;
+	OggIndex index;
+	index.start(name, rate, preSkip, 1);
+	if (!index.isEnabled() || index.fileName() != QString(name))
+		fail("not enabled");
+
+	// header pages, then audio pages with their end granule positions
+	const qint64 pages[] = {
+		0, 0,
+		preSkip + 24000, preSkip + 48000, -1, preSkip + 72000,
+		preSkip + 200000, preSkip + 216000
+	};
+	const int pageCount = sizeof(pages) / sizeof(pages[0]);
+	for (int i = 0; i < pageCount; i++) {
+		index.addPage(pages[i], i * 1000);
+		// the pages are written behind the index
+		if (i == 4)
+			index.flush(1500);
+	}
+
+	// the entry for time 0 is at the first page with samples, the one for
+	// 1 second at the page after the one without a packet end, and the
+	// long page at 6000 holds those for 2, 3 and 4 seconds
+	const qint64 entries[] = {
+		0, 2000,
+		preSkip + 48000, 5000,
+		preSkip + 72000, 6000,
+		preSkip + 72000, 6000,
+		preSkip + 72000, 6000,
+	};
+
+	// the first audio page has not been written yet
+	checkFile(name, rate, preSkip, 1, entries, 0);
+
+	// the page at 5000 is not written yet
+	index.flush(5000);
+	checkFile(name, rate, preSkip, 1, entries, 1);
+
+	index.flush(5001);
+	checkFile(name, rate, preSkip, 1, entries, 2);
+
+	index.close();
+	checkFile(name, rate, preSkip, 1, entries, 5);
+
+	unlink(name);
+}
+
+void checkDisabled() {
+	what = "disabled";
+	char name[] = "/tmp/oggindextestXXXXXX";
+	int fd = mkstemp(name);
+	if (fd < 0) {
+		fail("could not create a temporary file");
+		return;
+	}
+	close(fd);
+	unlink(name);
+
+	OggIndex index;
+	index.start(name, 16000, 0, 0);
+	index.addPage(100000, 0);
+	index.flush(1000);
+	index.close();
+	if (index.isEnabled())
+		fail("enabled");
+	if (access(name, F_OK) == 0) {
+		fail("the file was created");
+		unlink(name);
+	}
+}
+}
+
+int main() {
+	checkStream();
+	checkDisabled();
+
+	if (failures) {
+		std::printf("%d failures\n", failures);
+		return 1;
+	}
+
+	std::printf("checked\n");
+	return 0;
+}
+
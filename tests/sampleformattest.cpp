@@ -0,0 +1,190 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+// Checks that the SSE2 and AVX2 sample format conversions give exactly the
+// same results as the portable ones, for all lengths up to a few vectors,
+// unaligned buffers, and values that must saturate.  versions the CPU can't
+// run are skipped
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#include "sampleformat.h"
+
+namespace {
+const long maxSamples = 200;
+// room for the unaligned start and for catching writes past the end
+const int slack = 8;
+const qint16 guard = 0x5a5a;
+
+int failures = 0;
+
+void fail(const char *impl, const char *function, long samples, int offset) {
+	std::printf("FAIL: %s %s, %ld samples at offset %d\n", impl, function, samples, offset);
+	failures++;
+}
+
+qint16 randomSample() {
+	// the extremes are the interesting ones, so make them common
+	switch (std::rand() % 8) {
+	case 0: return -32768;
+	case 1: return 32767;
+	default: return (qint16)(std::rand() & 0xffff);
+	}
+}
+
+float randomFloat() {
+	switch (std::rand() % 12) {
+	case 0: return 1.0f;
+	case 1: return -1.0f;
+	case 2: return 1.5f;
+	case 3: return -100.0f;
+	case 4: return std::numeric_limits<float>::infinity();
+	case 5: return -std::numeric_limits<float>::infinity();
+	case 6: return std::numeric_limits<float>::quiet_NaN();
+	// exactly between two integers
+	case 7: return ((std::rand() % 65536) - 32768 + 0.5f) / 32768.0f;
+	default: return (float)std::rand() / RAND_MAX * 2.0f - 1.0f;
+	}
+}
+
+void fillGuard(qint16 *buffer, long size) {
+	for (long i = 0; i < size; i++)
+		buffer[i] = guard;
+}
+
+// runs every conversion with the given version and with the portable one,
+// and compares the outputs including what lies around them
+void check(const char *impl, long samples, int offset) {
+	qint16 left[maxSamples + slack], right[maxSamples + slack];
+	qint16 interleaved[maxSamples * 2 + slack];
+	float floats[maxSamples + slack];
+
+	for (long i = 0; i < maxSamples + slack; i++) {
+		left[i] = randomSample();
+		right[i] = randomSample();
+		floats[i] = randomFloat();
+	}
+	for (long i = 0; i < maxSamples * 2 + slack; i++)
+		interleaved[i] = randomSample();
+
+	qint16 expected[2][maxSamples * 2 + slack], actual[2][maxSamples * 2 + slack];
+	float expectedFloat[maxSamples + slack], actualFloat[maxSamples + slack];
+	size_t size = sizeof(expected[0]);
+
+	// interleave
+	fillGuard(expected[0], maxSamples * 2 + slack);
+	fillGuard(actual[0], maxSamples * 2 + slack);
+	setSampleFormatImplementation("scalar");
+	interleave(expected[0] + offset, left + offset, right + offset, samples);
+	setSampleFormatImplementation(impl);
+	interleave(actual[0] + offset, left + offset, right + offset, samples);
+	if (std::memcmp(expected[0], actual[0], size) != 0)
+		fail(impl, "interleave", samples, offset);
+
+	// deinterleave
+	for (int c = 0; c < 2; c++) {
+		fillGuard(expected[c], maxSamples * 2 + slack);
+		fillGuard(actual[c], maxSamples * 2 + slack);
+	}
+	setSampleFormatImplementation("scalar");
+	deinterleave(expected[0] + offset, expected[1] + offset, interleaved + offset, samples);
+	setSampleFormatImplementation(impl);
+	deinterleave(actual[0] + offset, actual[1] + offset, interleaved + offset, samples);
+	if (std::memcmp(expected, actual, sizeof(expected)) != 0)
+		fail(impl, "deinterleave", samples, offset);
+
+	// s16ToFloat
+	std::memset(expectedFloat, 0, sizeof(expectedFloat));
+	std::memset(actualFloat, 0, sizeof(actualFloat));
+	setSampleFormatImplementation("scalar");
+	s16ToFloat(expectedFloat + offset, left + offset, samples);
+	setSampleFormatImplementation(impl);
+	s16ToFloat(actualFloat + offset, left + offset, samples);
+	if (std::memcmp(expectedFloat, actualFloat, sizeof(expectedFloat)) != 0)
+		fail(impl, "s16ToFloat", samples, offset);
+
+	// floatToS16
+	fillGuard(expected[0], maxSamples * 2 + slack);
+	fillGuard(actual[0], maxSamples * 2 + slack);
+	setSampleFormatImplementation("scalar");
+	floatToS16(expected[0] + offset, floats + offset, samples);
+	setSampleFormatImplementation(impl);
+	floatToS16(actual[0] + offset, floats + offset, samples);
+	if (std::memcmp(expected[0], actual[0], size) != 0)
+		fail(impl, "floatToS16", samples, offset);
+}
+
+// the portable version itself, at the limits
+void checkSaturation(const char *impl) {
+	const float input[] = { 1.0f, -1.0f, 1.5f, -1.5f, 1e10f, -1e10f, 32767.0f / 32768.0f, 0.0f,
+		std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(),
+		std::numeric_limits<float>::quiet_NaN(), 0.5f / 32768.0f, 1.5f / 32768.0f, -0.5f / 32768.0f,
+		-1.5f / 32768.0f, 0.25f, 1.0f, -1.0f };
+	const qint16 expected[] = { 32767, -32768, 32767, -32768, 32767, -32768, 32767, 0,
+		32767, -32768, -32768, 0, 2, 0, -2, 8192, 32767, -32768 };
+	const long samples = sizeof(input) / sizeof(input[0]);
+
+	qint16 output[samples];
+	setSampleFormatImplementation(impl);
+	floatToS16(output, input, samples);
+	for (long i = 0; i < samples; i++) {
+		if (output[i] != expected[i]) {
+			std::printf("FAIL: %s floatToS16 saturation, input %g gave %d instead of %d\n",
+				impl, input[i], output[i], expected[i]);
+			failures++;
+		}
+	}
+}
+}
+
+int main() {
+	const char *impls[] = { "scalar", "SSE2", "AVX2" };
+
+	std::srand(1);
+
+	for (int i = 0; i < 3; i++) {
+		if (!setSampleFormatImplementation(impls[i])) {
+			std::printf("%s: not supported by this CPU, skipped\n", impls[i]);
+			continue;
+		}
+
+		checkSaturation(impls[i]);
+		for (long samples = 0; samples <= maxSamples; samples++)
+			for (int offset = 0; offset < 4; offset++)
+				for (int round = 0; round < 4; round++)
+					check(impls[i], samples, offset);
+
+		std::printf("%s: checked\n", impls[i]);
+	}
+
+	if (failures) {
+		std::printf("%d failures\n", failures);
+		return 1;
+	}
+
+	return 0;
+}
+
@@ -0,0 +1,372 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+// Writes WAV files through a FileSink with the "sync" backend and checks
+// the header that WaveHeader writes and patches: its layout, that the sizes
+// follow the data that was written, and the switch to RF64 exactly when the
+// RIFF size reaches 0xffffffff.  the sizes near 4 GiB are only claimed, the
+// file itself stays small.  readWaveHeader() must find the samples in those
+// files, and in others with more chunks
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+#include "waveheader.h"
+#include "filesink.h"
+
+namespace {
+const int headerSize = 80;
+
+int failures = 0;
+
+// the file being checked, with a description for the messages
+int fd = -1;
+const char *what = "";
+
+quint64 getUInt(const unsigned char *d, int bytes) {
+	quint64 i = 0;
+	for (int j = bytes - 1; j >= 0; j--)
+		i = (i << 8) | d[j];
+	return i;
+}
+
+bool fail(const char *message) {
+	std::printf("FAIL: %s: %s\n", what, message);
+	failures++;
+	return false;
+}
+
+// writes the header, flushes the sink and reads the header back
+bool writeHeader(WaveHeader &header, FileSink &sink, qint64 size, unsigned char *buffer) {
+	if (!header.update(sink, size) || !sink.flush())
+		return fail("could not update the header");
+	if (pread(fd, buffer, headerSize, 0) != headerSize)
+		return fail("could not read the header back");
+	return true;
+}
+
+void expectTag(const unsigned char *header, int pos, const char *tag) {
+	if (std::memcmp(header + pos, tag, 4) != 0) {
+		std::printf("FAIL: %s: expected '%s' at %d, found '%.4s'\n", what, tag, pos, header + pos);
+		failures++;
+	}
+}
+
+void expectUInt(const unsigned char *header, int pos, int bytes, quint64 expected, const char *field) {
+	quint64 found = getUInt(header + pos, bytes);
+	if (found != expected) {
+		std::printf("FAIL: %s: %s is %llu instead of %llu\n", what, field,
+			(unsigned long long)found, (unsigned long long)expected);
+		failures++;
+	}
+}
+
+// checks everything but the sizes
+void checkLayout(const unsigned char *header, bool rf64, long sampleRate, int channels) {
+	expectTag(header, 0, rf64 ? "RF64" : "RIFF");
+	expectTag(header, 8, "WAVE");
+	expectTag(header, 12, rf64 ? "ds64" : "JUNK");
+	expectUInt(header, 16, 4, 28, "ds64 chunk size");
+	expectTag(header, 48, "fmt ");
+	expectUInt(header, 52, 4, 16, "fmt chunk size");
+	expectUInt(header, 56, 2, 1, "compression code");
+	expectUInt(header, 58, 2, channels, "channels");
+	expectUInt(header, 60, 4, sampleRate, "sample rate");
+	expectUInt(header, 64, 4, sampleRate * channels * 2, "bytes per second");
+	expectUInt(header, 68, 2, channels * 2, "block align");
+	expectUInt(header, 70, 2, 16, "bits per sample");
+	expectTag(header, 72, "data");
+	// the table of the ds64 chunk is always empty
+	expectUInt(header, 44, 4, 0, "ds64 table size");
+}
+
+void checkSizes(const unsigned char *header, bool rf64, quint64 fileSize, int channels) {
+	quint64 dataSize = fileSize - headerSize;
+	if (rf64) {
+		expectUInt(header, 4, 4, 0xffffffffu, "RIFF size");
+		expectUInt(header, 76, 4, 0xffffffffu, "data size");
+		expectUInt(header, 20, 8, fileSize - 8, "ds64 RIFF size");
+		expectUInt(header, 28, 8, dataSize, "ds64 data size");
+		expectUInt(header, 36, 8, dataSize / (channels * 2), "ds64 sample count");
+	} else {
+		expectUInt(header, 4, 4, fileSize - 8, "RIFF size");
+		expectUInt(header, 76, 4, dataSize, "data size");
+		for (int pos = 20; pos < 44; pos += 8)
+			expectUInt(header, pos, 8, 0, "unused ds64 field");
+	}
+}
+
+// the name of the temporary file, while it exists
+char name[] = "/tmp/waveheadertestXXXXXX";
+
+bool createFile() {
+	std::strcpy(name + std::strlen(name) - 6, "XXXXXX");
+	fd = mkstemp(name);
+	if (fd < 0)
+		return fail("could not create a temporary file");
+	return true;
+}
+
+// reads the header of the temporary file back, which is then removed
+void checkRead(bool valid, int channels, long sampleRate, qint64 dataOffset) {
+	QFile file(name);
+	int c = 0;
+	long r = 0;
+	qint64 o = 0;
+	bool ok = file.open(QIODevice::ReadOnly) && readWaveHeader(file, c, r, o);
+	file.close();
+	unlink(name);
+	close(fd);
+
+	if (ok != valid)
+		fail(valid ? "readWaveHeader() rejected the file" : "readWaveHeader() accepted the file");
+	else if (valid && (c != channels || r != sampleRate || o != dataOffset))
+		fail("readWaveHeader() got the format or the offset wrong");
+}
+
+bool openSink(FileSink &sink, long blockSize) {
+	if (!createFile())
+		return false;
+
+	if (!sink.open(fd, blockSize, 0, "sync", 1))
+		return fail("could not open the sink");
+	return true;
+}
+
+// a header followed by real samples, updated while the data is written
+void checkRecording(long blockSize, int channels) {
+	what = channels == 2 ? "stereo" : "mono";
+
+	FileSink sink;
+	if (!openSink(sink, blockSize))
+		return;
+
+	WaveHeader header;
+	unsigned char buffer[headerSize];
+	if (!header.write(sink, 16000, channels) || !sink.flush()) {
+		fail("could not write the header");
+		return;
+	}
+	if (pread(fd, buffer, headerSize, 0) != headerSize) {
+		fail("could not read the header back");
+		return;
+	}
+	checkLayout(buffer, false, 16000, channels);
+	// nothing is known yet
+	expectUInt(buffer, 4, 4, 0, "RIFF size");
+	expectUInt(buffer, 76, 4, 0, "data size");
+
+	char samples[1000];
+	for (int i = 0; i < (int)sizeof(samples); i++)
+		samples[i] = (char)i;
+
+	qint64 size = headerSize;
+	for (int round = 0; round < 20; round++) {
+		long bytes = (round * 37 % 10 + 1) * channels * 2 * 23;
+		if (!sink.write(samples, bytes) || !sink.flush()) {
+			fail("could not write samples");
+			return;
+		}
+		size += bytes;
+
+		if (sink.flushedSize() != size)
+			fail("the sink did not flush everything");
+
+		if (!writeHeader(header, sink, sink.flushedSize(), buffer))
+			return;
+		checkLayout(buffer, false, 16000, channels);
+		checkSizes(buffer, false, size, channels);
+	}
+
+	// the samples behind the header must not have been touched
+	char data[sizeof(samples)];
+	long bytes = channels * 2 * 23;
+	if (pread(fd, data, bytes, headerSize) != bytes || std::memcmp(data, samples, bytes) != 0)
+		fail("the samples after the header were changed");
+
+	sink.close();
+	checkRead(true, channels, 16000, headerSize);
+}
+
+// the sizes around the 4 GiB limit
+void checkRf64() {
+	what = "RF64 switch";
+
+	FileSink sink;
+	if (!openSink(sink, 4096))
+		return;
+
+	WaveHeader header;
+	unsigned char buffer[headerSize];
+	if (!header.write(sink, 16000, 2) || !sink.flush()) {
+		fail("could not write the header");
+		return;
+	}
+
+	// the largest RIFF size that is not the RF64 marker
+	quint64 size = Q_UINT64_C(0xfffffffe) + 8;
+	if (!writeHeader(header, sink, size, buffer))
+		return;
+	if (header.isRf64())
+		fail("switched below the limit");
+	checkLayout(buffer, false, 16000, 2);
+	checkSizes(buffer, false, size, 2);
+
+	// a RIFF size of exactly 0xffffffff would be read as the marker
+	size++;
+	if (!writeHeader(header, sink, size, buffer))
+		return;
+	if (!header.isRf64())
+		fail("did not switch at the limit");
+	checkLayout(buffer, true, 16000, 2);
+	checkSizes(buffer, true, size, 2);
+
+	// and it keeps growing
+	size = Q_UINT64_C(0x280000000) + headerSize;
+	if (!writeHeader(header, sink, size, buffer))
+		return;
+	checkLayout(buffer, true, 16000, 2);
+	checkSizes(buffer, true, size, 2);
+
+	// the claimed size is ignored, the samples go to the end of the file
+	sink.close();
+	checkRead(true, 2, 16000, headerSize);
+}
+
+void appendUInt(QByteArray &array, quint32 i, int bytes) {
+	for (int j = 0; j < bytes; j++)
+		array.append((char)(i >> (8 * j)));
+}
+
+void appendChunk(QByteArray &array, const char *name, const QByteArray &body) {
+	array.append(name);
+	appendUInt(array, body.size(), 4);
+	array.append(body);
+	if (body.size() & 1)
+		array.append((char)0);
+}
+
+QByteArray fmtChunk(int compression, int channels, long sampleRate, int bits) {
+	QByteArray body;
+	appendUInt(body, compression, 2);
+	appendUInt(body, channels, 2);
+	appendUInt(body, sampleRate, 4);
+	appendUInt(body, sampleRate * channels * bits / 8, 4);
+	appendUInt(body, channels * bits / 8, 2);
+	appendUInt(body, bits, 2);
+	return body;
+}
+
+// writes a file with the given chunks and reads it back
+void checkChunks(const char *description, const char *type, const QByteArray &chunks, bool valid,
+	int channels = 0, long sampleRate = 0, qint64 dataOffset = 0)
+{
+	what = description;
+	if (!createFile())
+		return;
+
+	QByteArray data(type);
+	appendUInt(data, chunks.size() + 4, 4);
+	data.append("WAVE");
+	data.append(chunks);
+	if (write(fd, data.constData(), data.size()) != data.size()) {
+		fail("could not write the file");
+		close(fd);
+		unlink(name);
+		return;
+	}
+
+	checkRead(valid, channels, sampleRate, dataOffset);
+}
+
+// files written by others, with chunks WaveWriter doesn't write
+void checkOtherFiles() {
+	QByteArray samples(100, 1);
+	QByteArray fmt = fmtChunk(1, 2, 44100, 16);
+
+	QByteArray chunks;
+	appendChunk(chunks, "fmt ", fmt);
+	appendChunk(chunks, "data", samples);
+	checkChunks("plain", "RIFF", chunks, true, 2, 44100, 44);
+	checkChunks("not WAVE", "RIFX", chunks, false);
+
+	// odd sized chunks are padded
+	chunks.clear();
+	appendChunk(chunks, "LIST", QByteArray(5, 'x'));
+	appendChunk(chunks, "fmt ", fmtChunk(1, 1, 8000, 16));
+	appendChunk(chunks, "fact", QByteArray(4, 0));
+	appendChunk(chunks, "data", samples);
+	checkChunks("extra chunks", "RIFF", chunks, true, 1, 8000, 12 + 14 + 24 + 12 + 8);
+
+	chunks.clear();
+	appendChunk(chunks, "data", samples);
+	appendChunk(chunks, "fmt ", fmt);
+	checkChunks("data before fmt", "RIFF", chunks, false);
+
+	chunks.clear();
+	appendChunk(chunks, "fmt ", fmtChunk(3, 2, 44100, 32));
+	appendChunk(chunks, "data", samples);
+	checkChunks("float samples", "RIFF", chunks, false);
+
+	chunks.clear();
+	appendChunk(chunks, "fmt ", fmtChunk(1, 6, 44100, 16));
+	appendChunk(chunks, "data", samples);
+	checkChunks("6 channels", "RIFF", chunks, false);
+
+	chunks.clear();
+	appendChunk(chunks, "fmt ", fmt);
+	checkChunks("no data", "RIFF", chunks, false);
+
+	chunks.clear();
+	appendChunk(chunks, "fmt ", fmt);
+	chunks.truncate(20);
+	checkChunks("truncated", "RIFF", chunks, false);
+}
+}
+
+int main() {
+	// the smallest block, which the header leaves early on, and one that
+	// holds the whole recording, so the header is patched in the buffer
+	const long blockSizes[] = { 4096, 65536 };
+
+	for (int i = 0; i < 2; i++) {
+		checkRecording(blockSizes[i], 1);
+		checkRecording(blockSizes[i], 2);
+	}
+	checkRf64();
+	checkOtherFiles();
+
+	if (failures) {
+		std::printf("%d failures\n", failures);
+		return 1;
+	}
+
+	std::printf("checked\n");
+	return 0;
+}
+
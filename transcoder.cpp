@@ -0,0 +1,303 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+#include <QFile>
+#include <QDir>
+#include <QThread>
+#include <QTimer>
+#include <QAtomicInt>
+#include <QByteArray>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "transcoder.h"
+#include "common.h"
+#include "preferences.h"
+#include "writer.h"
+#include "sampleformat.h"
+#include "waveheader.h"
+
+// TranscodeThread - reads the samples of a spool file and gives them to an
+// opened writer, then closes it
+
+class TranscodeThread : public QThread {
+public:
+	TranscodeThread(const QString &fn, qint64 o, int c, AudioFileWriter *w) :
+		fileName(fn), offset(o), channels(c), writer(w), aborted(0), success(false) { }
+
+	void abort() { aborted.fetchAndStoreOrdered(1); }
+	bool succeeded() const { return success; }
+
+protected:
+	virtual void run() {
+		// on Linux, this only changes the priority of the calling thread
+		setpriority(PRIO_PROCESS, 0, 19);
+
+		QFile file(fileName);
+		if (!file.open(QIODevice::ReadOnly) || !file.seek(offset))
+			return;
+
+		const long chunkSize = 16384;
+		QByteArray left(chunkSize * 2, 0);
+		QByteArray right(chunkSize * 2, 0);
+
+		for (;;) {
+			if (aborted.fetchAndAddAcquire(0))
+				return;
+
+			QByteArray data = file.read(chunkSize * channels * 2);
+			long samples = data.size() / (channels * 2);
+			bool last = data.size() < chunkSize * channels * 2;
+			const qint16 *pcm = reinterpret_cast<const qint16 *>(data.constData());
+
+			bool ret;
+			if (channels == 2) {
+				qint16 *l = reinterpret_cast<qint16 *>(left.data());
+				qint16 *r = reinterpret_cast<qint16 *>(right.data());
+				deinterleave(l, r, pcm, samples);
+				ret = writer->write(l, r, samples, last);
+			} else {
+				ret = writer->write(pcm, NULL, samples, last);
+			}
+
+			// the other formats carry on without it
+			QStringList lost = writer->takeLostFileNames();
+			for (int i = 0; i < lost.size(); i++) {
+				debug(QString("Removing '%1'").arg(lost.at(i)));
+				QFile::remove(lost.at(i));
+			}
+
+			if (!ret)
+				return;
+			if (last)
+				break;
+		}
+
+		writer->close();
+		success = true;
+	}
+
+private:
+	QString fileName;
+	qint64 offset;
+	int channels;
+	AudioFileWriter *writer;
+	QAtomicInt aborted;
+	bool success;
+};
+
+// TranscodeQueue
+
+TranscodeQueue *TranscodeQueue::queue = NULL;
+
+TranscodeQueue *TranscodeQueue::instance() {
+	if (!queue)
+		queue = new TranscodeQueue;
+	return queue;
+}
+
+void TranscodeQueue::destroy() {
+	delete queue;
+	queue = NULL;
+}
+
+TranscodeQueue::TranscodeQueue() :
+	thread(NULL),
+	writer(NULL)
+{
+	load();
+	if (!jobs.isEmpty()) {
+		debug(QString("Resuming %1 transcoding jobs").arg(jobs.size()));
+		QTimer::singleShot(0, this, SLOT(startNext()));
+	}
+}
+
+TranscodeQueue::~TranscodeQueue() {
+	// the running job stays in the queue and is redone next time
+	abort();
+}
+
+void TranscodeQueue::add(const TranscodeJob &job) {
+	jobs.append(job);
+	save();
+
+	// not right away, so that a recording that is deleted right after
+	// stopping can still be removed from the queue before it started
+	QTimer::singleShot(0, this, SLOT(startNext()));
+}
+
+void TranscodeQueue::remove(const QString &spoolFile) {
+	for (int i = 0; i < jobs.size(); i++) {
+		if (jobs.at(i).spoolFile != spoolFile)
+			continue;
+
+		if (i == 0 && thread) {
+			// all outputs, including extra formats and seek indexes
+			QStringList outputs = writer->fileNames();
+			abort();
+			for (int j = 0; j < outputs.size(); j++) {
+				debug(QString("Removing '%1'").arg(outputs.at(j)));
+				QFile::remove(outputs.at(j));
+			}
+			QTimer::singleShot(0, this, SLOT(startNext()));
+		}
+
+		jobs.removeAt(i);
+		save();
+		return;
+	}
+}
+
+void TranscodeQueue::abort() {
+	if (!thread)
+		return;
+
+	disconnect(thread, 0, this, 0);
+	thread->abort();
+	thread->wait();
+	delete thread;
+	thread = NULL;
+	delete writer;
+	writer = NULL;
+}
+
+void TranscodeQueue::startNext() {
+	while (!thread && !jobs.isEmpty()) {
+		const TranscodeJob &job = jobs.first();
+
+		QFile file(job.spoolFile);
+		int channels;
+		long sampleRate;
+		qint64 offset;
+
+		if (!file.open(QIODevice::ReadOnly)) {
+			debug(QString("WARNING: cannot open spool file '%1', dropping it from the queue").arg(job.spoolFile));
+			jobs.removeFirst();
+			save();
+			continue;
+		}
+
+		if (!readWaveHeader(file, channels, sampleRate, offset)) {
+			debug(QString("WARNING: '%1' is not a valid spool file, leaving it as it is").arg(job.spoolFile));
+			jobs.removeFirst();
+			save();
+			continue;
+		}
+
+		file.close();
+
+		// the writer is set up here, since it reads the preferences
+		writer = AudioFileWriter::create(job.format);
+		if (job.saveTags)
+			writer->setTags(job.tagComment, job.tagTime);
+
+		if (!writer->open(job.target, sampleRate, channels == 2)) {
+			debug(QString("WARNING: cannot open output file for '%1', leaving it as it is").arg(job.spoolFile));
+			delete writer;
+			writer = NULL;
+			jobs.removeFirst();
+			save();
+			continue;
+		}
+
+		debug(QString("Transcoding '%1' to '%2'").arg(job.spoolFile).arg(writer->fileName()));
+
+		thread = new TranscodeThread(job.spoolFile, offset, channels, writer);
+		connect(thread, SIGNAL(finished()), this, SLOT(jobFinished()));
+		thread->start();
+	}
+}
+
+void TranscodeQueue::jobFinished() {
+	bool success = thread->succeeded();
+	delete thread;
+	thread = NULL;
+
+	TranscodeJob job = jobs.takeFirst();
+	save();
+
+	if (success) {
+		debug(QString("Transcoded '%1', removing it").arg(job.spoolFile));
+		QFile::remove(job.spoolFile);
+	} else {
+		debug(QString("WARNING: could not transcode '%1', leaving it as it is").arg(job.spoolFile));
+	}
+
+	delete writer;
+	writer = NULL;
+
+	startNext();
+}
+
+// the queue is stored in the same format as the preferences
+
+namespace {
+QString queueFile() {
+	return QDir::homePath() + "/.skypecallrecorder.queue";
+}
+}
+
+void TranscodeQueue::load() {
+	if (!QFile::exists(queueFile()))
+		return;
+
+	BasePreferences p;
+	if (!p.load(queueFile()))
+		return;
+
+	int n = p.get("jobs").toInt();
+	for (int i = 0; i < n; i++) {
+		QString prefix = QString("job.%1.").arg(i);
+		TranscodeJob job;
+		job.spoolFile = p.get(prefix + "spool").toString();
+		job.target = p.get(prefix + "target").toString();
+		job.format = p.get(prefix + "format").toString();
+		job.saveTags = p.get(prefix + "tags").toBool();
+		job.tagComment = p.get(prefix + "comment").toString();
+		job.tagTime = QDateTime::fromString(p.get(prefix + "time").toString(), Qt::ISODate);
+		if (!job.spoolFile.isEmpty() && !job.target.isEmpty())
+			jobs.append(job);
+	}
+}
+
+void TranscodeQueue::save() {
+	if (jobs.isEmpty()) {
+		QFile::remove(queueFile());
+		return;
+	}
+
+	BasePreferences p;
+	p.get("jobs").set(jobs.size());
+	for (int i = 0; i < jobs.size(); i++) {
+		const TranscodeJob &job = jobs.at(i);
+		QString prefix = QString("job.%1.").arg(i);
+		p.get(prefix + "spool").set(job.spoolFile);
+		p.get(prefix + "target").set(job.target);
+		p.get(prefix + "format").set(job.format);
+		p.get(prefix + "tags").set(job.saveTags);
+		p.get(prefix + "comment").set(job.tagComment);
+		p.get(prefix + "time").set(job.tagTime.toString(Qt::ISODate));
+	}
+	p.save(queueFile());
+}
+
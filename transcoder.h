@@ -0,0 +1,90 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+#ifndef TRANSCODER_H
+#define TRANSCODER_H
+
+#include <QObject>
+#include <QString>
+#include <QDateTime>
+#include <QList>
+
+#include "common.h"
+
+class AudioFileWriter;
+class TranscodeThread;
+
+// a recording that was spooled to a WAV file and still has to be encoded to
+// its final format
+
+struct TranscodeJob {
+	TranscodeJob() : saveTags(false) { }
+
+	QString spoolFile;
+	// the file name without extension, as given to AudioFileWriter::open()
+	QString target;
+	QString format;
+	bool saveTags;
+	QString tagComment;
+	QDateTime tagTime;
+};
+
+// the jobs are done one at a time, by a thread with the lowest CPU
+// priority.  the queue is saved to disk whenever it changes, so jobs that
+// are interrupted by quitting are redone on the next start
+
+class TranscodeQueue : public QObject {
+	Q_OBJECT
+public:
+	static TranscodeQueue *instance();
+	static void destroy();
+
+	void add(const TranscodeJob &);
+	// drops the job of the given spool file, aborting it if it is running
+	void remove(const QString &);
+
+private slots:
+	void startNext();
+	void jobFinished();
+
+private:
+	TranscodeQueue();
+	~TranscodeQueue();
+
+	void load();
+	void save();
+	void abort();
+
+private:
+	static TranscodeQueue *queue;
+
+	QList<TranscodeJob> jobs;
+	// the running job is always the first one
+	TranscodeThread *thread;
+	AudioFileWriter *writer;
+
+	DISABLE_COPY_AND_ASSIGNMENT(TranscodeQueue);
+};
+
+#endif
+
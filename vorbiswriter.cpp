@@ -25,19 +25,45 @@
 // files.  it is mostly based on the examples/encoder_example.c from the vorbis
 // library, so have a look there if you're curious about how this works.
 
-// TODO: currently, this only writes tags while opening the file, but doesn't
-// update them if they've been changed before close().  for now this is ok, as
-// it never happens.
+// the comment header is padded and put on a page of its own, so that tags
+// changed after opening can be written in place when closing, without
+// touching anything else in the file.
 
 #include <QByteArray>
 #include <QString>
+#include <QDateTime>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <vorbis/vorbisenc.h>
 
 #include "vorbiswriter.h"
 #include "common.h"
 #include "preferences.h"
+#include "sampleformat.h"
+
+namespace {
+// size the comment header packet is padded to when opening.  decoders
+// ignore what comes after the framing bit
+const int commentSize = 4096;
+
+void addTags(vorbis_comment *vc, const QString &comment, const QDateTime &time) {
+	// vorbis_comment_add_tag() in libvorbis up to version 1.2.0
+	// incorrectly takes a char * instead of a const char *.  to prevent
+	// compiler warnings we use const_cast<>(), since it's known that
+	// libvorbis does not change the arguments.
+	vorbis_comment_add_tag(vc, const_cast<char *>("COMMENT"), const_cast<char *>(comment.toUtf8().constData()));
+	vorbis_comment_add_tag(vc, const_cast<char *>("DATE"), const_cast<char *>(time.toString("yyyy-MM-dd hh:mm").toAscii().constData()));
+	vorbis_comment_add_tag(vc, const_cast<char *>("GENRE"), const_cast<char *>("Speech (Skype Call)"));
+}
+
+QByteArray padComment(const ogg_packet &packet, long size) {
+	QByteArray data(reinterpret_cast<const char *>(packet.packet), packet.bytes);
+	if (data.size() < size)
+		data.append(QByteArray(size - data.size(), 0));
+	return data;
+}
+}
 
 struct VorbisWriterPrivateData {
 	ogg_stream_state os;
@@ -51,7 +77,9 @@ struct VorbisWriterPrivateData {
 
 VorbisWriter::VorbisWriter() :
 	pd(NULL),
-	hasFlushed(false)
+	hasFlushed(false),
+	commentOffset(-1),
+	commentBodySize(0)
 {
 }
 
@@ -77,7 +105,7 @@ bool VorbisWriter::open(const QString &fn, long sr, bool s) {
 	if (!b)
 		return false;
 
-	int quality = preferences.get(Pref::OutputFormatVorbisQuality).toInt();
+	int quality = prefs->get(Pref::OutputFormatVorbisQuality).toInt();
 
 	pd = new VorbisWriterPrivateData;
 	vorbis_info_init(&pd->vi);
@@ -92,13 +120,7 @@ bool VorbisWriter::open(const QString &fn, long sr, bool s) {
 	// with vorbis_encode_ctl(), but I didn't find anything concrete
 
 	vorbis_comment_init(&pd->vc);
-	// vorbis_comment_add_tag() in libvorbis up to version 1.2.0
-	// incorrectly takes a char * instead of a const char *.  to prevent
-	// compiler warnings we use const_cast<>(), since it's known that
-	// libvorbis does not change the arguments.
-	vorbis_comment_add_tag(&pd->vc, const_cast<char *>("COMMENT"), const_cast<char *>(tagComment.toUtf8().constData()));
-	vorbis_comment_add_tag(&pd->vc, const_cast<char *>("DATE"), const_cast<char *>(tagTime.toString("yyyy-MM-dd hh:mm").toAscii().constData()));
-	vorbis_comment_add_tag(&pd->vc, const_cast<char *>("GENRE"), const_cast<char *>("Speech (Skype Call)"));
+	addTags(&pd->vc, tagComment, tagTime);
 
 	vorbis_analysis_init(&pd->vd, &pd->vi);
 	vorbis_block_init(&pd->vd, &pd->vb);
@@ -111,18 +133,100 @@ bool VorbisWriter::open(const QString &fn, long sr, bool s) {
 	ogg_packet header_code;
 
 	vorbis_analysis_headerout(&pd->vd, &pd->vc, &header, &header_comm, &header_code);
+
+	// the first page must only contain the identification header
 	ogg_stream_packetin(&pd->os, &header);
+	if (!writeHeaderPages())
+		return false;
+
+	QByteArray comment = padComment(header_comm, commentSize);
+	commentBodySize = comment.size();
+	header_comm.packet = reinterpret_cast<unsigned char *>(comment.data());
+	header_comm.bytes = comment.size();
 	ogg_stream_packetin(&pd->os, &header_comm);
+	commentOffset = sink.size();
+	commentPage.clear();
+	if (!writeHeaderPages())
+		return false;
+
 	ogg_stream_packetin(&pd->os, &header_code);
+	if (!writeHeaderPages())
+		return false;
+
+	mustWriteTags = false;
+
+	index.start(file.fileName() + ".idx", sampleRate, 0, prefs->get(Pref::OutputOggIndex).toInt());
+
+	return true;
+}
+
+bool VorbisWriter::writeHeaderPages() {
+	// the page with the comment header is remembered, so it can be
+	// rewritten later.  that only works if the page holds the whole
+	// packet, which a huge one wouldn't
 
 	while (ogg_stream_flush(&pd->os, &pd->og) != 0) {
-		file.write((const char *)pd->og.header, pd->og.header_len);
-		file.write((const char *)pd->og.body, pd->og.body_len);
+		if (commentPage.isEmpty() && commentOffset == sink.size()) {
+			if (pd->og.body_len == commentBodySize)
+				commentPage = QByteArray((const char *)pd->og.header, pd->og.header_len);
+			else
+				commentOffset = -1;
+		}
+
+		if (!sink.write((const char *)pd->og.header, pd->og.header_len) ||
+				!sink.write((const char *)pd->og.body, pd->og.body_len))
+			return false;
 	}
 
 	return true;
 }
 
+bool VorbisWriter::writeTags() {
+	if (!mustWriteTags)
+		return true;
+
+	if (commentPage.isEmpty()) {
+		debug("WARNING: VorbisWriter: the comment header can't be rewritten, not updating the tags");
+		return false;
+	}
+
+	vorbis_comment vc;
+	ogg_packet packet;
+	vorbis_comment_init(&vc);
+	addTags(&vc, tagComment, tagTime);
+	int ret = vorbis_commentheader_out(&vc, &packet);
+	vorbis_comment_clear(&vc);
+	if (ret != 0)
+		return false;
+
+	// the new page must be exactly as big as the one written at open
+	QByteArray body = padComment(packet, commentBodySize);
+	ogg_packet_clear(&packet);
+
+	if (body.size() != commentBodySize) {
+		debug("WARNING: VorbisWriter: tags don't fit in the reserved space, not updating them");
+		return false;
+	}
+
+	debug("Writing tags to Ogg Vorbis file");
+
+	// same page, new contents.  only the checksum changes in the header
+	QByteArray header = commentPage;
+	ogg_page page;
+	page.header = reinterpret_cast<unsigned char *>(header.data());
+	page.header_len = header.size();
+	page.body = reinterpret_cast<unsigned char *>(body.data());
+	page.body_len = body.size();
+	ogg_page_checksum_set(&page);
+
+	header.append(body);
+	if (!sink.writeAt(commentOffset, header.constData(), header.size()))
+		return false;
+
+	mustWriteTags = false;
+	return true;
+}
+
 void VorbisWriter::close() {
 	if (!file.isOpen()) {
 		debug("WARNING: VorbisWriter::close() called, but file not open");
@@ -131,18 +235,37 @@ void VorbisWriter::close() {
 
 	if (!hasFlushed) {
 		debug("WARNING: VorbisWriter::close() called but no flush happened, flushing now");
-		QByteArray dummy1, dummy2;
-		write(dummy1, dummy2, 0, true);
+		write(NULL, NULL, 0, true);
 	}
 
+	if (!writeTags())
+		debug(QString("WARNING: could not write tags to '%1'").arg(file.fileName()));
+
+	index.close();
+
 	AudioFileWriter::close();
 }
 
-bool VorbisWriter::write(QByteArray &left, QByteArray &right, long samples, bool flush) {
+QStringList VorbisWriter::fileNames() const {
+	QStringList list(fileName());
+	if (index.isEnabled())
+		list.append(index.fileName());
+	return list;
+}
+
+bool VorbisWriter::write(const qint16 *left, const qint16 *right, long samples, bool flush) {
+	return writeShared(SampleBuffer(left, right, samples), flush);
+}
+
+bool VorbisWriter::writeShared(const SampleBuffer &b, bool flush) {
 	const long maxChunkSize = 4096;
 
-	const qint16 *leftData = (const qint16 *)left.constData();
-	const qint16 *rightData = stereo ? (const qint16 *)right.constData() : NULL;
+	const qint16 *leftData = b.left;
+	const qint16 *rightData = stereo ? b.right : NULL;
+	// already converted samples, if any
+	const float *leftFloat = b.leftFloat;
+	const float *rightFloat = stereo ? b.rightFloat : NULL;
+	long samples = b.samples;
 
 	long todoSamples = samples;
 	int eos = 0;
@@ -159,13 +282,19 @@ bool VorbisWriter::write(QByteArray &left, QByteArray &right, long samples, bool
 		} else {
 			float **buffer = vorbis_analysis_buffer(&pd->vd, chunkSize);
 
-			for (long i = 0; i < chunkSize; i++)
-				buffer[0][i] = (float)leftData[i] / 32768.0f;
-			leftData += chunkSize;
+			if (leftFloat) {
+				std::memcpy(buffer[0], leftFloat, chunkSize * sizeof(float));
+				leftFloat += chunkSize;
+			} else {
+				s16ToFloat(buffer[0], leftData, chunkSize);
+				leftData += chunkSize;
+			}
 
-			if (stereo) {
-				for (long i = 0; i < chunkSize; i++)
-					buffer[1][i] = (float)rightData[i] / 32768.0f;
+			if (stereo && rightFloat) {
+				std::memcpy(buffer[1], rightFloat, chunkSize * sizeof(float));
+				rightFloat += chunkSize;
+			} else if (stereo) {
+				s16ToFloat(buffer[1], rightData, chunkSize);
 				rightData += chunkSize;
 			}
 
@@ -180,8 +309,10 @@ bool VorbisWriter::write(QByteArray &left, QByteArray &right, long samples, bool
 				ogg_stream_packetin(&pd->os, &pd->op);
 
 				while (!eos && ogg_stream_pageout(&pd->os, &pd->og) != 0) {
-					file.write((const char *)pd->og.header, pd->og.header_len);
-					file.write((const char *)pd->og.body, pd->og.body_len);
+					index.addPage(ogg_page_granulepos(&pd->og), sink.size());
+					if (!sink.write((const char *)pd->og.header, pd->og.header_len) ||
+							!sink.write((const char *)pd->og.body, pd->og.body_len))
+						return false;
 
 					if (ogg_page_eos(&pd->og))
 						eos = 1;
@@ -192,10 +323,10 @@ bool VorbisWriter::write(QByteArray &left, QByteArray &right, long samples, bool
 
 	samplesWritten += samples;
 
-	left.remove(0, samples * 2);
-	if (stereo)
-		right.remove(0, samples * 2);
+	if (flush && !sink.flush())
+		return false;
 
+	index.flush(sink.flushedSize());
 	return true;
 }
 
@@ -24,11 +24,13 @@
 #ifndef VORBISWRITER_H
 #define VORBISWRITER_H
 
+#include <QByteArray>
+
 #include "common.h"
 #include "writer.h"
+#include "oggindex.h"
 
 class QString;
-class QByteArray;
 struct VorbisWriterPrivateData;
 
 class VorbisWriter : public AudioFileWriter {
@@ -38,11 +40,24 @@ public:
 
 	virtual bool open(const QString &, long, bool);
 	virtual void close();
-	virtual bool write(QByteArray &, QByteArray &, long, bool = false);
+	virtual bool write(const qint16 *, const qint16 *, long, bool = false);
+	virtual int sharedConversions() const { return Float; }
+	virtual bool writeShared(const SampleBuffer &, bool);
+	virtual QStringList fileNames() const;
+
+private:
+	bool writeHeaderPages();
+	bool writeTags();
 
 private:
 	VorbisWriterPrivateData *pd;
 	bool hasFlushed;
+	// where the page with the comment header is, its header and the size
+	// of its body
+	qint64 commentOffset;
+	QByteArray commentPage;
+	long commentBodySize;
+	OggIndex index;
 
 	DISABLE_COPY_AND_ASSIGNMENT(VorbisWriter);
 };
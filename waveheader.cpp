@@ -0,0 +1,204 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+#include <QByteArray>
+#include <QFile>
+
+#include "waveheader.h"
+#include "common.h"
+#include "filesink.h"
+
+// little-endian helper class
+
+class LittleEndianArray : public QByteArray {
+public:
+	void appendUInt16(int i) {
+		append((char)i);
+		append((char)(i >> 8));
+	}
+
+	void appendUInt32(long i) {
+		append((char)i);
+		append((char)(i >> 8));
+		append((char)(i >> 16));
+		append((char)(i >> 24));
+	}
+};
+
+namespace {
+void setUInt32(QByteArray &array, int pos, qint64 i) {
+	char *d = array.data() + pos;
+	d[0] = (char)i;
+	d[1] = (char)(i >> 8);
+	d[2] = (char)(i >> 16);
+	d[3] = (char)(i >> 24);
+}
+
+void setUInt64(QByteArray &array, int pos, qint64 i) {
+	setUInt32(array, pos, i);
+	setUInt32(array, pos + 4, i >> 32);
+}
+
+quint32 getUInt32(const char *d) {
+	const uchar *u = reinterpret_cast<const uchar *>(d);
+	return u[0] | (u[1] << 8) | (u[2] << 16) | ((quint32)u[3] << 24);
+}
+
+int getUInt16(const char *d) {
+	const uchar *u = reinterpret_cast<const uchar *>(d);
+	return u[0] | (u[1] << 8);
+}
+
+// the largest size a RIFF header can hold.  RF64 puts this value in the
+// 32 bit fields to say that the real one is in the ds64 chunk
+const qint64 maxRiffSize = Q_INT64_C(0xffffffff);
+
+// size of the ds64 chunk, without the (empty) table
+const int ds64Size = 28;
+}
+
+WaveHeader::WaveHeader() :
+	fileSizeOffset(0),
+	ds64Offset(0),
+	dataSizeOffset(0),
+	blockAlign(0),
+	rf64(false),
+	fileSize(0)
+{
+}
+
+bool WaveHeader::write(FileSink &sink, long sampleRate, int channels) {
+	LittleEndianArray array;
+	array.reserve(44 + 8 + ds64Size);
+
+	// main header
+	array.append("RIFF");             // RIFF signature
+	fileSizeOffset = array.size();
+	array.appendUInt32(0);            // file size excluding signature and this size
+	array.append("WAVE");             // RIFF type
+	// placeholder for a ds64 chunk, in case the file grows too big
+	ds64Offset = array.size();
+	array.append("JUNK");             // chunk name
+	array.appendUInt32(ds64Size);     // chunk size excluding name and this size
+	array.append(QByteArray(ds64Size, 0));
+	// format chunk
+	array.append("fmt ");             // chunk name
+	array.appendUInt32(16);           // chunk size excluding name and this size
+	array.appendUInt16(1);            // compression code, 1 == PCM uncompressed
+	array.appendUInt16(channels);     // number of channels
+	array.appendUInt32(sampleRate);   // sample rate
+	array.appendUInt32(channels * 2 * sampleRate); // average bytes per second, block align * sample rate
+	array.appendUInt16(channels * 2); // block align for each sample group, (usually) significant bits / 8 * number of channels
+	array.appendUInt16(16);           // significant bits per sample
+	// data chunk
+	array.append("data");             // chunk name
+	dataSizeOffset = array.size();
+	array.appendUInt32(0);            // chunk size excluding name and this size
+	// PCM data follows
+
+	if (!sink.write(array.constData(), array.size()))
+		return false;
+
+	header = array;
+	fileSize = array.size();
+	blockAlign = channels * 2;
+	rf64 = false;
+
+	// Note: the file size field and the "data" chunk size field can't be
+	// filled in yet, which is why we put zero in there for now.  some
+	// players can play those files anyway, but we'll update these fields
+	// every now and then, so that even if we crash, we'll have a valid wav
+	// file (with potentially trailing data)
+
+	return true;
+}
+
+bool WaveHeader::update(FileSink &sink, qint64 size) {
+	if (size <= fileSize)
+		return true;
+	fileSize = size;
+
+	qint64 riffSize = size - 8;
+	qint64 dataSize = size - header.size();
+
+	// 0xffffffff itself is the marker telling readers to look at the ds64
+	// chunk, so it can't be used as a plain RIFF size
+	if (!rf64 && riffSize >= maxRiffSize) {
+		header.replace(0, 4, QByteArray("RF64"));
+		header.replace(ds64Offset, 4, QByteArray("ds64"));
+		rf64 = true;
+	}
+
+	// the whole header is rewritten at once, which leaves the position
+	// used for appending the audio data alone
+	if (rf64) {
+		setUInt32(header, fileSizeOffset, maxRiffSize);
+		setUInt32(header, dataSizeOffset, maxRiffSize);
+		setUInt64(header, ds64Offset + 8, riffSize);
+		setUInt64(header, ds64Offset + 16, dataSize);
+		setUInt64(header, ds64Offset + 24, dataSize / blockAlign);
+	} else {
+		setUInt32(header, fileSizeOffset, riffSize);
+		setUInt32(header, dataSizeOffset, dataSize);
+	}
+
+	return sink.writeAt(0, header.constData(), header.size());
+}
+
+bool readWaveHeader(QFile &file, int &channels, long &sampleRate, qint64 &dataOffset) {
+	QByteArray riff = file.read(12);
+	if (riff.size() != 12 || (!riff.startsWith("RIFF") && !riff.startsWith("RF64")) || riff.mid(8, 4) != "WAVE")
+		return false;
+
+	channels = 0;
+
+	for (;;) {
+		QByteArray chunk = file.read(8);
+		if (chunk.size() != 8)
+			return false;
+
+		QByteArray name = chunk.left(4);
+		quint32 size = getUInt32(chunk.constData() + 4);
+
+		if (name == "data") {
+			dataOffset = file.pos();
+			// the fmt chunk comes first
+			return channels == 1 || channels == 2;
+		}
+
+		QByteArray body = file.read(size);
+		if (body.size() != (int)size)
+			return false;
+		// chunks are padded to an even size
+		if (size & 1)
+			file.read(1);
+
+		if (name == "fmt ") {
+			if (size < 16 || getUInt16(body.constData()) != 1 || getUInt16(body.constData() + 14) != 16)
+				return false;
+			channels = getUInt16(body.constData() + 2);
+			sampleRate = getUInt32(body.constData() + 4);
+		}
+	}
+}
+
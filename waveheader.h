@@ -0,0 +1,74 @@
+/*
+	Skype Call Recorder
+	Copyright 2008-2010, 2013, 2015 by jlh (jlh at gmx dot ch)
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by the
+	Free Software Foundation; either version 2 of the License, version 3 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+	The GNU General Public License version 2 is included with the source of
+	this program under the file name COPYING.  You can also get a copy on
+	http://www.fsf.org/
+*/
+
+#ifndef WAVEHEADER_H
+#define WAVEHEADER_H
+
+#include <QByteArray>
+#include <QtGlobal>
+
+#include "common.h"
+
+class FileSink;
+class QFile;
+
+// the header of the WAV files written by WaveWriter.  the sizes in it can't
+// be known when it is written, so they are patched in place every now and
+// then, with one positional write of the whole header.  once the file
+// passes 4 GiB, the JUNK chunk becomes a ds64 chunk and the file is turned
+// into an RF64 file (EBU Tech 3306), which keeps the same layout, so
+// nothing else has to move
+
+class WaveHeader {
+public:
+	WaveHeader();
+
+	// writes the header of an empty file with the given sample rate and
+	// number of channels
+	bool write(FileSink &, long, int);
+	// patches the sizes for a file of the given total size, if it grew
+	bool update(FileSink &, qint64);
+
+	bool isRf64() const { return rf64; }
+
+private:
+	QByteArray header;
+	int fileSizeOffset;
+	int ds64Offset;
+	int dataSizeOffset;
+	int blockAlign;
+	bool rf64;
+	// the file size the header currently describes
+	qint64 fileSize;
+
+	DISABLE_COPY_AND_ASSIGNMENT(WaveHeader);
+};
+
+// finds the format and the start of the samples in a WAV file written by
+// WaveWriter, reading from the start of the given file.  the size of the
+// data chunk is not trusted, since it may not have been updated if we
+// crashed.  the samples go to the end of the file
+bool readWaveHeader(QFile &, int &, long &, qint64 &);
+
+#endif
+
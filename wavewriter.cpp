@@ -26,27 +26,13 @@
 
 #include "wavewriter.h"
 #include "common.h"
-
-// little-endian helper class
-
-class LittleEndianArray : public QByteArray {
-public:
-	void appendUInt16(int i) {
-		append((char)i);
-		append((char)(i >> 8));
-	}
-
-	void appendUInt32(long i) {
-		append((char)i);
-		append((char)(i >> 8));
-		append((char)(i >> 16));
-		append((char)(i >> 24));
-	}
-};
+#include "preferences.h"
+#include "sampleformat.h"
 
 // WaveWriter
 
 WaveWriter::WaveWriter() :
+	syncHeader(false),
 	hasFlushed(false)
 {
 }
@@ -64,48 +50,12 @@ bool WaveWriter::open(const QString &fn, long sr, bool s) {
 	if (!b)
 		return false;
 
-	updateHeaderInterval = sampleRate; // update header every second
-	nextUpdateHeader = sampleRate;
-
-	int channels = stereo ? 2 : 1;
-	LittleEndianArray array;
-	array.reserve(44);
-
-	// main header
-	array.append("RIFF");             // RIFF signature
-	fileSizeOffset = array.size();
-	array.appendUInt32(0);            // file size excluding signature and this size
-	array.append("WAVE");             // RIFF type
-	// format chunk
-	array.append("fmt ");             // chunk name
-	array.appendUInt32(16);           // chunk size excluding name and this size
-	array.appendUInt16(1);            // compression code, 1 == PCM uncompressed
-	array.appendUInt16(channels);     // number of channels
-	array.appendUInt32(sampleRate);   // sample rate
-	array.appendUInt32(channels * 2 * sampleRate); // average bytes per second, block align * sample rate
-	array.appendUInt16(channels * 2); // block align for each sample group, (usually) significant bits / 8 * number of channels
-	array.appendUInt16(16);           // significant bits per sample
-	// data chunk
-	array.append("data");             // chunk name
-	dataSizeOffset = array.size();
-	array.appendUInt32(0);            // chunk size excluding name and this size
-	// PCM data follows
-
-	qint64 w = file.write(array);
-
-	fileSize = array.size() - 8;
-	dataSize = 0;
-
-	if (w < 0)
-		return false;
+	// 0 means the header is only written when flushing
+	updateHeaderInterval = prefs->get(Pref::OutputWavHeaderInterval).toInt() * sampleRate;
+	nextUpdateHeader = updateHeaderInterval;
+	syncHeader = prefs->get(Pref::OutputDurability).toString() == "header";
 
-	// Note: the file size field and the "data" chunk size field can't be
-	// filled in yet, which is why we put zero in there for now.  some
-	// players can play those files anyway, but we'll seek back and update
-	// these fields every now and then, so that even if we crash, we'll
-	// have a valid wav file (with potentially trailing data)
-
-	return true;
+	return header.write(sink, sampleRate, stereo ? 2 : 1);
 }
 
 void WaveWriter::close() {
@@ -116,72 +66,77 @@ void WaveWriter::close() {
 
 	if (!hasFlushed) {
 		debug("WARNING: WaveWriter::close() called but no flush happened, flushing now");
-		QByteArray dummy1, dummy2;
-		write(dummy1, dummy2, 0, true);
+		write(NULL, NULL, 0, true);
 	}
 
 	AudioFileWriter::close();
 }
 
-bool WaveWriter::write(QByteArray &left, QByteArray &right, long samples, bool flush) {
-	QByteArray output;
-
-	if (stereo) {
-		// interleave data... TODO: is this something that advanced
-		// processors instructions can handle faster?
-
-		output.resize(samples * 4);
-		qint16 *outputData = reinterpret_cast<qint16 *>(output.data());
-		qint16 *leftData = reinterpret_cast<qint16 *>(left.data());
-		qint16 *rightData = reinterpret_cast<qint16 *>(right.data());
+bool WaveWriter::write(const qint16 *left, const qint16 *right, long samples, bool flush) {
+	return writeShared(SampleBuffer(left, right, samples), flush);
+}
 
-		for (long i = 0; i < samples; i++) {
-			outputData[i * 2] = leftData[i];
-			outputData[i * 2 + 1] = rightData[i];
-		}
+bool WaveWriter::writeShared(const SampleBuffer &b, bool flush) {
+	const char *output;
+	qint64 bytes;
+	long samples = b.samples;
+
+	if (stereo && b.interleaved) {
+		output = reinterpret_cast<const char *>(b.interleaved);
+		bytes = samples * 4;
+	} else if (stereo) {
+		interleaved.resize(samples * 4);
+		interleave(reinterpret_cast<qint16 *>(interleaved.data()), b.left, b.right, samples);
+		output = interleaved.constData();
+		bytes = samples * 4;
 	} else {
-		output = left;
-		output.truncate(samples * 2);
+		// mono data is already in the right format, write it as is
+		output = reinterpret_cast<const char *>(b.left);
+		bytes = samples * 2;
 	}
 
-	bool ret = file.write(output);
+	bool ret = sink.write(output, bytes);
 
-	fileSize += output.size();
-	dataSize += output.size();
 	samplesWritten += samples;
 
-	left.remove(0, samples * 2);
-	if (stereo)
-		right.remove(0, samples * 2);
-
-	if (!ret)
+	if (!ret || (flush && !sink.flush()))
 		return false;
 
 	nextUpdateHeader -= samples;
-	if (flush || nextUpdateHeader <= 0) {
+	if (flush || (updateHeaderInterval && nextUpdateHeader <= 0)) {
 		nextUpdateHeader = updateHeaderInterval;
-		updateHeader();
+		ret = updateHeader();
 
 		if (flush)
 			hasFlushed = true;
 	}
 
-	return true;
+	return ret;
 }
 
-void WaveWriter::updateHeader() {
-	qint64 pos = file.pos();
-	LittleEndianArray tmp;
+bool WaveWriter::syncsWithHeader() const {
+	// with an interval of 0, the header is only updated when flushing
+	return prefs->get(Pref::OutputWavHeaderInterval).toInt() != 0;
+}
+
+bool WaveWriter::updateHeader() {
+	// with durability "header", the data is synced to disk first, so the
+	// header never describes more than what is safely stored
+	if (syncHeader && !sink.sync()) {
+		debug(QString("WARNING: WaveWriter: could not sync '%1'").arg(file.fileName()));
+		return false;
+	}
 
-	tmp.appendUInt32(fileSize);
-	file.seek(fileSizeOffset);
-	file.write(tmp);
+	// the header only covers the data that has left the sink's buffer, so
+	// that it is never ahead of the file
+	bool wasRf64 = header.isRf64();
+	if (!header.update(sink, sink.flushedSize())) {
+		debug(QString("WARNING: WaveWriter: could not update header of '%1'").arg(file.fileName()));
+		return false;
+	}
 
-	tmp.clear();
-	tmp.appendUInt32(dataSize);
-	file.seek(dataSizeOffset);
-	file.write(tmp);
+	if (!wasRf64 && header.isRf64())
+		debug(QString("WaveWriter: '%1' passed 4 GiB, switched to RF64").arg(file.fileName()));
 
-	file.seek(pos);
+	return true;
 }
-
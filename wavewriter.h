@@ -24,11 +24,13 @@
 #ifndef WAVEWRITER_H
 #define WAVEWRITER_H
 
+#include <QByteArray>
+
 #include "common.h"
+#include "waveheader.h"
 #include "writer.h"
 
 class QString;
-class QByteArray;
 
 class WaveWriter : public AudioFileWriter {
 public:
@@ -37,19 +39,21 @@ public:
 
 	virtual bool open(const QString &, long, bool);
 	virtual void close();
-	virtual bool write(QByteArray &, QByteArray &, long, bool = false);
+	virtual bool write(const qint16 *, const qint16 *, long, bool = false);
+	virtual int sharedConversions() const { return stereo ? Interleaved : 0; }
+	virtual bool writeShared(const SampleBuffer &, bool);
+	virtual bool syncsWithHeader() const;
 
 private:
-	void updateHeader();
+	bool updateHeader();
 
 private:
 	long updateHeaderInterval;
 	long nextUpdateHeader;
-	int fileSizeOffset;
-	int dataSizeOffset;
-	qint64 fileSize;
-	qint64 dataSize;
+	bool syncHeader;
+	WaveHeader header;
 	bool hasFlushed;
+	QByteArray interleaved;
 
 	DISABLE_COPY_AND_ASSIGNMENT(WaveWriter);
 };
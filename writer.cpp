@@ -25,13 +25,37 @@
 #include <QDir>
 
 #include "writer.h"
+#include "wavewriter.h"
+#include "mp3writer.h"
+#include "vorbiswriter.h"
+#include "opuswriter.h"
+#include "flacwriter.h"
+#include "multiwriter.h"
 #include "common.h"
+#include "preferences.h"
+
+AudioFileWriter *AudioFileWriter::create(const QString &format) {
+	if (format.contains(','))
+		return new MultiWriter(format.split(',', QString::SkipEmptyParts));
+	else if (format == "wav")
+		return new WaveWriter;
+	else if (format == "mp3")
+		return new Mp3Writer;
+	else if (format == "opus")
+		return new OpusWriter;
+	else if (format == "flac")
+		return new FlacWriter;
+	else /*if (format == "vorbis")*/
+		return new VorbisWriter;
+}
 
 AudioFileWriter::AudioFileWriter() :
+	prefs(&preferences),
 	sampleRate(0),
 	stereo(false),
 	samplesWritten(0),
-	mustWriteTags(true)
+	mustWriteTags(true),
+	syncOnClose(false)
 {
 }
 
@@ -42,6 +66,10 @@ AudioFileWriter::~AudioFileWriter() {
 	}
 }
 
+void AudioFileWriter::setPreferences(BasePreferences *p) {
+	prefs = p;
+}
+
 void AudioFileWriter::setTags(const QString &comment, const QDateTime &t) {
 	tagComment = comment;
 	tagTime = t;
@@ -59,7 +87,29 @@ bool AudioFileWriter::open(const QString &fn, long sr, bool s) {
 
 	debug(QString("Opening '%1'").arg(file.fileName()));
 
-	return file.open(QIODevice::WriteOnly);
+	if (!file.open(QIODevice::WriteOnly))
+		return false;
+
+	long blockSize = prefs->get(Pref::OutputBufferSize).toInt() * 1024;
+	int flushInterval = prefs->get(Pref::OutputBufferFlushInterval).toInt();
+	QString backend = prefs->get(Pref::OutputIoBackend).toString();
+	int inFlight = prefs->get(Pref::OutputIoInFlight).toInt();
+
+	if (!sink.open(file.handle(), blockSize, flushInterval, backend, inFlight)) {
+		file.close();
+		return false;
+	}
+
+	// the syncs happen on the thread doing the writing, which is never the
+	// one capturing the audio.  "header" means syncing before each header
+	// update, which only writers that update their header periodically
+	// can do.  the others sync periodically instead
+	QString durability = prefs->get(Pref::OutputDurability).toString();
+	syncOnClose = durability != "none";
+	if (durability == "periodic" || (durability == "header" && !syncsWithHeader()))
+		sink.setSyncInterval(prefs->get(Pref::OutputDurabilityInterval).toInt());
+
+	return true;
 }
 
 void AudioFileWriter::close() {
@@ -68,7 +118,17 @@ void AudioFileWriter::close() {
 		return;
 	}
 
-	debug(QString("Closing '%1', wrote %2 samples, %3 seconds").arg(file.fileName()).arg(samplesWritten).arg(samplesWritten / sampleRate));
+	if (syncOnClose && !sink.sync())
+		debug(QString("WARNING: could not sync '%1'").arg(file.fileName()));
+	if (!sink.close())
+		debug(QString("WARNING: could not write the end of '%1'").arg(file.fileName()));
+
+	debug(QString("Closing '%1', wrote %2 samples, %3 seconds, %4 bytes in %5 writes").arg(file.fileName())
+		.arg(samplesWritten).arg(samplesWritten / sampleRate).arg(sink.size()).arg(sink.writeCount()));
+	if (sink.syncCount())
+		debug(QString("%1 syncs, %2 ms average, %3 ms maximum").arg(sink.syncCount())
+			.arg(sink.syncTotalTime() / sink.syncCount() / 1000.0, 0, 'f', 1)
+			.arg(sink.syncMaxTime() / 1000.0, 0, 'f', 1));
 	return file.close();
 }
 
@@ -27,16 +27,46 @@
 #include <QFile>
 #include <QDateTime>
 #include <QString>
+#include <QStringList>
+#include <QtGlobal>
 
 #include "common.h"
+#include "filesink.h"
 
-class QByteArray;
+class BasePreferences;
+
+// a block of samples, together with converted versions of them.  when
+// writing several files at once, each conversion is only done once.  the
+// converted versions are NULL unless a writer asked for them
+
+struct SampleBuffer {
+	SampleBuffer(const qint16 *l, const qint16 *r, long s) :
+		left(l), right(r), samples(s), interleaved(NULL), leftFloat(NULL), rightFloat(NULL) { }
+
+	const qint16 *left;
+	const qint16 *right;
+	long samples;
+	// LRLR..., only for stereo
+	const qint16 *interleaved;
+	// divided by 32768, see s16ToFloat()
+	const float *leftFloat;
+	const float *rightFloat;
+};
 
 class AudioFileWriter {
 public:
 	AudioFileWriter();
 	virtual ~AudioFileWriter();
 
+	// creates a writer for "mp3", "vorbis", "opus", "flac" or "wav".  a
+	// comma separated list of these writes all of them at once
+	static AudioFileWriter *create(const QString &);
+
+	// the preferences that open() reads, the global ones by default.
+	// those may only be used by the GUI thread, so a writer opened by
+	// another thread must be given a copy of them first
+	virtual void setPreferences(BasePreferences *);
+
 	// tags should be set before open() if possible, but can also be set
 	// and re-set later, but not after close().  tags will be written to
 	// disk at arbitrary times, but close() guarantees they are written.
@@ -47,11 +77,37 @@ public:
 	// Note: you're not supposed to reopen after a close
 	virtual bool open(const QString &, long, bool);
 	virtual void close();
-	virtual bool write(QByteArray &, QByteArray &, long, bool = false) = 0;
-	QString fileName() const { return file.fileName(); }
+	// writes the given number of samples from the left and right
+	// channels.  for mono files, the right channel is ignored and may be
+	// NULL.  the data is owned by the caller and is not modified.  when
+	// flushing, the sample count may be zero and the pointers NULL
+	virtual bool write(const qint16 *, const qint16 *, long, bool = false) = 0;
+
+	// the conversions the writer can take from a SampleBuffer
+	enum { Interleaved = 1, Float = 2 };
+	virtual int sharedConversions() const { return 0; }
+	// like write(), but uses the conversions in the buffer if present
+	virtual bool writeShared(const SampleBuffer &b, bool flush) { return write(b.left, b.right, b.samples, flush); }
+
+	// whether the writer syncs before each periodic header update, for
+	// the durability policy "header"
+	virtual bool syncsWithHeader() const { return false; }
+
+	virtual QString fileName() const { return file.fileName(); }
+	virtual QStringList fileNames() const { return QStringList(fileName()); }
+	// the files of outputs that failed since the last call, while others
+	// carried on.  they are closed and no longer in fileNames(), and are
+	// left for the caller to remove
+	virtual QStringList takeLostFileNames() { return QStringList(); }
+	// bytes written so far, including what is still buffered
+	virtual qint64 size() const { return sink.size(); }
 
 protected:
+	// the file is only used to open and close it.  all output goes
+	// through the sink
 	QFile file;
+	FileSink sink;
+	BasePreferences *prefs;
 	long sampleRate;
 	bool stereo;
 	qint64 samplesWritten;
@@ -59,6 +115,9 @@ protected:
 	QDateTime tagTime;
 	bool mustWriteTags;
 
+private:
+	bool syncOnClose;
+
 	DISABLE_COPY_AND_ASSIGNMENT(AudioFileWriter);
 };
 